@@ -0,0 +1,208 @@
+/* GStreamer
+ * Copyright (C) <2008> Zhao Liang <zlweb@163.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+/* Build and query a lyrics search index from the command line:
+ *
+ *   gst-lrc-search add catalog.lrcf *.lrc
+ *   gst-lrc-search query catalog.lrcf "some words"
+ *
+ * add parses the files with the batch API and appends them to the index,
+ * which is created when it does not exist yet. query prints one line per
+ * hit: the file, the time of the cue and the cue number. */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <string.h>
+#include <gst/gst.h>
+#include "gstlrcbatch.h"
+#include "gstlrcsearch.h"
+
+static gint n_threads = 0;
+
+static GOptionEntry entries[] = {
+  {"threads", 'j', 0, G_OPTION_ARG_INT, &n_threads,
+      "Parse on N threads, 0 for one per processor", "N"},
+  {NULL}
+};
+
+/* the existing index, NULL if there is none and FALSE on errors */
+static gboolean
+load_index (const gchar * path, GstLrcSearch ** search)
+{
+  GstBuffer *buf;
+  GError *err = NULL;
+  gchar *data;
+  gsize size;
+
+  *search = NULL;
+  if (!g_file_test (path, G_FILE_TEST_EXISTS))
+    return TRUE;
+
+  if (!g_file_get_contents (path, &data, &size, &err)) {
+    g_printerr ("could not read %s: %s\n", path, err->message);
+    g_error_free (err);
+    return FALSE;
+  }
+
+  buf = gst_buffer_new ();
+  GST_BUFFER_DATA (buf) = (guint8 *) data;
+  GST_BUFFER_SIZE (buf) = size;
+  GST_BUFFER_MALLOCDATA (buf) = (guint8 *) data;
+  *search = gst_lrc_search_read (buf);
+  gst_buffer_unref (buf);
+
+  if (!*search) {
+    g_printerr ("%s is not a lyrics search index\n", path);
+    return FALSE;
+  }
+  return TRUE;
+}
+
+static gboolean
+save_index (const gchar * path, GstLrcSearch * search)
+{
+  GstBuffer *buf;
+  GError *err = NULL;
+  gboolean ret;
+
+  buf = gst_lrc_search_write (search);
+  ret = g_file_set_contents (path, (const gchar *) GST_BUFFER_DATA (buf),
+      GST_BUFFER_SIZE (buf), &err);
+  gst_buffer_unref (buf);
+
+  if (!ret) {
+    g_printerr ("could not write %s: %s\n", path, err->message);
+    g_error_free (err);
+  }
+  return ret;
+}
+
+/* Results come back as the files finish, they are added to the index in
+ * the order of the command line so that file numbers are stable. */
+static gint
+add_files (const gchar * path, gchar ** files, guint n_files)
+{
+  GstLrcSearch *search;
+  GstLrcBatch *batch;
+  GstLrcBatchResult *result;
+  GstLrcBatchResult **results;
+  guint i, failed = 0;
+
+  if (!load_index (path, &search))
+    return 1;
+  if (!search)
+    search = gst_lrc_search_new ();
+
+  batch = gst_lrc_batch_new (n_threads);
+  for (i = 0; i < n_files; i++)
+    gst_lrc_batch_add_file (batch, files[i]);
+  gst_lrc_batch_start (batch);
+
+  results = g_new0 (GstLrcBatchResult *, n_files);
+  while ((result = gst_lrc_batch_next (batch)))
+    results[result->id] = result;
+
+  for (i = 0; i < n_files; i++) {
+    result = results[i];
+    if (result->index) {
+      gst_lrc_search_add (search, result->path, result->index);
+    } else {
+      g_printerr ("%s: %s\n", result->path, result->error->message);
+      failed++;
+    }
+    gst_lrc_batch_result_free (result);
+  }
+  g_free (results);
+  gst_lrc_batch_free (batch);
+
+  if (!save_index (path, search))
+    failed = n_files;
+  g_print ("%u files in %s, %u could not be added\n",
+      gst_lrc_search_get_n_files (search), path, failed);
+  gst_lrc_search_free (search);
+
+  return failed > 0;
+}
+
+static gint
+query_index (const gchar * path, gchar ** words, guint n_words)
+{
+  GstLrcSearch *search;
+  GstLrcSearchHit *hit;
+  GArray *hits;
+  GString *text;
+  guint i;
+
+  if (!load_index (path, &search))
+    return 1;
+  if (!search) {
+    g_printerr ("%s does not exist\n", path);
+    return 1;
+  }
+
+  text = g_string_new (words[0]);
+  for (i = 1; i < n_words; i++)
+    g_string_append_printf (text, " %s", words[i]);
+
+  hits = gst_lrc_search_query (search, text->str, -1);
+  for (i = 0; i < hits->len; i++) {
+    hit = &g_array_index (hits, GstLrcSearchHit, i);
+    g_print ("%s\t%" GST_TIME_FORMAT "\t%u\n",
+        gst_lrc_search_get_name (search, hit->file),
+        GST_TIME_ARGS (hit->time), hit->cue);
+  }
+
+  g_array_free (hits, TRUE);
+  g_string_free (text, TRUE);
+  gst_lrc_search_free (search);
+
+  return 0;
+}
+
+int
+main (int argc, char *argv[])
+{
+  GOptionContext *ctx;
+  GError *err = NULL;
+
+  ctx = g_option_context_new ("add INDEX FILE... | query INDEX WORDS...");
+  g_option_context_add_main_entries (ctx, entries, NULL);
+  g_option_context_add_group (ctx, gst_init_get_option_group ());
+  if (!g_option_context_parse (ctx, &argc, &argv, &err)) {
+    g_printerr ("%s\n", err->message);
+    g_error_free (err);
+    g_option_context_free (ctx);
+    return 1;
+  }
+  g_option_context_free (ctx);
+
+  gst_init (NULL, NULL);
+  gst_lrc_init ();
+
+  if (argc >= 4 && strcmp (argv[1], "add") == 0)
+    return add_files (argv[2], argv + 3, argc - 3);
+  if (argc >= 4 && strcmp (argv[1], "query") == 0)
+    return query_index (argv[2], argv + 3, argc - 3);
+
+  g_printerr ("usage: %s add INDEX FILE... | query INDEX WORDS...\n",
+      argv[0]);
+  return 1;
+}
@@ -50,16 +50,160 @@
 #include <string.h>
 #include "gstlrcdemux.h"
 #include "gstlrcsink.h"
+#include "gstlrcindexenc.h"
+#ifdef HAVE_LRC_OVERLAY
+#include "gstlrcoverlay.h"
+#endif
+#include "gstlrcparse.h"
+#include "gstlrcbinary.h"
+
+#define GST_CAT_DEFAULT lrcparse_debug
+
+/* bytes looked at by the typefinder, fewer for a short stream of unknown
+ * length, down to about a timestamp and a short line */
+#define LRC_TYPE_FIND_SIZE 512
+#define LRC_TYPE_FIND_MIN_SIZE 16
+
+static GstStaticCaps lrc_caps = GST_STATIC_CAPS (LRC_CAPS);
+static GstStaticCaps lrc_binary_caps = GST_STATIC_CAPS (LRC_BINARY_CAPS);
+static GstStaticCaps lrc_type_find_caps =
+GST_STATIC_CAPS (LRC_CAPS "; " LRC_BINARY_CAPS);
+
+static gchar *lrc_exts[] = { "lrc", NULL };
+
+/* Decide from the first bytes only. UTF-8 and 8 bit text is taken as is,
+ * UTF-16 is recognised by its byte order mark or by the zero high byte of
+ * a leading '['; the lines are then classified on the low bytes. NULs or
+ * control characters mean binary data. */
+static void
+gst_lrc_type_find (GstTypeFind * tf, gpointer unused)
+{
+  gchar text[LRC_TYPE_FIND_SIZE];
+  const guint8 *data;
+  const gchar *line, *end, *eol;
+  guint64 length;
+  guint size, i, n, step = 1, low = 0;
+  guint timed = 0, tags = 0, other = 0;
+  gboolean complete, first_known = FALSE;
+  GstLrcLineKind kind;
+  guint prob;
+
+  size = LRC_TYPE_FIND_SIZE;
+  length = gst_type_find_get_length (tf);
+  if (length > 0 && length < size)
+    size = length;
+  data = gst_type_find_peek (tf, 0, size);
+  while (!data && length == 0 && size > LRC_TYPE_FIND_MIN_SIZE) {
+    size /= 2;
+    data = gst_type_find_peek (tf, 0, size);
+  }
+  if (!data)
+    return;
+  complete = length > 0 && length == size;
+
+  if (gst_lrc_binary_detect (data, size)) {
+    gst_type_find_suggest (tf, GST_TYPE_FIND_MAXIMUM,
+        gst_static_caps_get (&lrc_binary_caps));
+    return;
+  }
+
+  if (size >= 3 && data[0] == 0xef && data[1] == 0xbb && data[2] == 0xbf) {
+    data += 3;
+    size -= 3;
+  } else if (size >= 2 && data[0] == 0xff && data[1] == 0xfe) {
+    data += 2;
+    size -= 2;
+    step = 2;
+  } else if (size >= 2 && data[0] == 0xfe && data[1] == 0xff) {
+    data += 2;
+    size -= 2;
+    step = 2;
+    low = 1;
+  } else if (size >= 2 && data[0] == '[' && data[1] == 0) {
+    step = 2;
+  } else if (size >= 2 && data[0] == 0 && data[1] == '[') {
+    step = 2;
+    low = 1;
+  }
+
+  for (i = 0, n = 0; i + step <= size; i += step) {
+    guint8 c = data[i + low];
+
+    if (step == 2 && data[i + 1 - low] != 0)
+      c = 0x80;                 /* not ascii, only text lines have those */
+    else if (c < 0x20 && c != '\t' && c != '\r' && c != '\n')
+      return;
+    text[n++] = c;
+  }
+
+  line = text;
+  end = text + n;
+  while (line < end) {
+    eol = line;
+    while (eol < end && *eol != '\n' && *eol != '\r')
+      eol++;
+    /* the cut off last line only counts at the end of the stream */
+    if (eol == end && !complete)
+      break;
+
+    while (line < eol && (*line == ' ' || *line == '\t'))
+      line++;
+    if (line < eol) {
+      kind = gst_lrc_classify_line (line, eol - line);
+      if (kind == GST_LRC_LINE_TIMED)
+        timed++;
+      else if (kind == GST_LRC_LINE_TAG)
+        tags++;
+      else
+        other++;
+      if (timed + tags + other == 1)
+        first_known = kind != GST_LRC_LINE_OTHER;
+    }
+    line = eol + 1;
+  }
+
+  /* Files start with header tags or timed lines, and those make up most of
+   * them. [mm:ss.xx] at the start of a line is rare outside lrc, a lone
+   * header tag much less so. */
+  if (timed + tags == 0)
+    return;
+  if (!first_known)
+    prob = GST_TYPE_FIND_POSSIBLE;
+  else if (timed >= 2 && timed + tags > other)
+    prob = GST_TYPE_FIND_MAXIMUM;
+  else if (timed >= 1 || (tags >= 2 && other == 0))
+    prob = GST_TYPE_FIND_LIKELY;
+  else
+    prob = GST_TYPE_FIND_POSSIBLE;
+
+  GST_DEBUG ("lrc typefind: %u timed, %u tags, %u other lines, "
+      "probability %u", timed, tags, other, prob);
+  gst_type_find_suggest (tf, prob, gst_static_caps_get (&lrc_caps));
+}
 
 static gboolean
 plugin_init (GstPlugin * plugin)
 {
+  gst_lrc_init ();
+
   gst_element_register (plugin, "lrcdemux",
       GST_RANK_PRIMARY, GST_TYPE_LRC_DEMUX);
   
   gst_element_register (plugin, "lrcsink",
       GST_RANK_PRIMARY, GST_TYPE_LRC_SINK);
 
+  gst_element_register (plugin, "lrcindexenc",
+      GST_RANK_NONE, GST_TYPE_LRC_INDEX_ENC);
+
+#ifdef HAVE_LRC_OVERLAY
+  gst_element_register (plugin, "lrcoverlay",
+      GST_RANK_NONE, GST_TYPE_LRC_OVERLAY);
+#endif
+
+  gst_type_find_register (plugin, LRC_CAPS, GST_RANK_PRIMARY,
+      gst_lrc_type_find, lrc_exts, gst_static_caps_get (&lrc_type_find_caps),
+      NULL, NULL);
+
   return TRUE;
 }
 
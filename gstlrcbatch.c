@@ -0,0 +1,265 @@
+/* GStreamer
+ * Copyright (C) <2008> Zhao Liang <zlweb@163.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "gstlrcbatch.h"
+#include "gstlrcbinary.h"
+#include "gstlrccharset.h"
+
+#define GST_CAT_DEFAULT lrcparse_debug
+
+typedef struct _GstLrcBatchSource {
+  gchar         *path;
+  const guint8  *data;
+  gsize          size;
+} GstLrcBatchSource;
+
+struct _GstLrcBatch {
+  guint          n_threads;
+  GArray        *sources;
+
+  GThread      **threads;
+  guint          n_running;
+
+  /* the next source to hand out; workers take them with an atomic add */
+  volatile gint  next;
+
+  GAsyncQueue   *results;
+  guint          delivered;
+};
+
+/* Create a batch run by n_threads workers, 0 for one per processor. */
+GstLrcBatch *
+gst_lrc_batch_new (guint n_threads)
+{
+  GstLrcBatch *batch;
+
+  /* usable without the plugin being loaded */
+  gst_lrc_init ();
+
+  if (n_threads == 0)
+    n_threads = gst_lrc_n_processors ();
+
+  batch = g_slice_new0 (GstLrcBatch);
+  batch->n_threads = n_threads;
+  batch->sources = g_array_new (FALSE, FALSE, sizeof (GstLrcBatchSource));
+  batch->results = g_async_queue_new ();
+
+  return batch;
+}
+
+/* Adds a file, returns the id of its result. */
+guint
+gst_lrc_batch_add_file (GstLrcBatch * batch, const gchar * path)
+{
+  GstLrcBatchSource source;
+
+  g_return_val_if_fail (batch->threads == NULL, 0);
+
+  source.path = g_strdup (path);
+  source.data = NULL;
+  source.size = 0;
+  g_array_append_val (batch->sources, source);
+
+  return batch->sources->len - 1;
+}
+
+/* Adds lyrics in memory, returns the id of its result. The data is not
+ * copied; a binary index keeps pointing into it, so it must outlive the
+ * results. */
+guint
+gst_lrc_batch_add_data (GstLrcBatch * batch, const guint8 * data, gsize size)
+{
+  GstLrcBatchSource source;
+
+  g_return_val_if_fail (batch->threads == NULL, 0);
+
+  source.path = NULL;
+  source.data = data;
+  source.size = size;
+  g_array_append_val (batch->sources, source);
+
+  return batch->sources->len - 1;
+}
+
+static GstBuffer *
+gst_lrc_batch_load (const GstLrcBatchSource * source, GError ** error)
+{
+  GstBuffer *buf;
+
+  if (source->path)
+    return gst_lrc_buffer_new_mapped (source->path, error);
+
+  buf = gst_buffer_new ();
+  GST_BUFFER_DATA (buf) = (guint8 *) source->data;
+  GST_BUFFER_SIZE (buf) = source->size;
+  return buf;
+}
+
+/* the same steps as lrcdemux in pull mode */
+static GstLrcBatchResult *
+gst_lrc_batch_process (GstLrcBatch * batch, GstLrcParser * parser, guint id)
+{
+  GstLrcBatchSource *source;
+  GstLrcBatchResult *result;
+  GstLrcConverter conv;
+  GstBuffer *buf;
+  const gchar *text;
+  gsize len;
+
+  source = &g_array_index (batch->sources, GstLrcBatchSource, id);
+  result = g_slice_new0 (GstLrcBatchResult);
+  result->id = id;
+  result->path = g_strdup (source->path);
+
+  buf = gst_lrc_batch_load (source, &result->error);
+  if (!buf)
+    return result;
+
+  if (gst_lrc_binary_detect (GST_BUFFER_DATA (buf), GST_BUFFER_SIZE (buf))) {
+    result->index = gst_lrc_binary_read (buf, TRUE);
+    if (!result->index)
+      g_set_error (&result->error, GST_STREAM_ERROR, GST_STREAM_ERROR_DECODE,
+          "corrupt binary lyrics index");
+  } else {
+    gst_lrc_converter_init (&conv, NULL);
+    text = gst_lrc_converter_convert_all (&conv,
+        (const gchar *) GST_BUFFER_DATA (buf), GST_BUFFER_SIZE (buf), &len);
+    gst_lrc_parser_parse (parser, text, len);
+    gst_lrc_converter_clear (&conv);
+    result->index = gst_lrc_parser_finish (parser);
+  }
+  gst_buffer_unref (buf);
+
+  if (result->index && result->index->n_cues == 0) {
+    gst_lrc_index_unref (result->index);
+    result->index = NULL;
+    g_set_error (&result->error, GST_STREAM_ERROR,
+        GST_STREAM_ERROR_WRONG_TYPE, "no timed lyrics");
+  }
+
+  GST_LOG ("%s: %u cues", GST_STR_NULL (source->path),
+      result->index ? result->index->n_cues : 0);
+  return result;
+}
+
+/* Nothing of the parser outlives a file: finish hands its cues and text
+ * to the index and frees the rest. */
+static gpointer
+gst_lrc_batch_worker (gpointer data)
+{
+  GstLrcBatch *batch = data;
+  GstLrcParser parser;
+  guint id;
+
+  gst_lrc_parser_init (&parser);
+
+  for (;;) {
+#if GLIB_CHECK_VERSION (2, 30, 0)
+    id = g_atomic_int_add (&batch->next, 1);
+#else
+    id = g_atomic_int_exchange_and_add (&batch->next, 1);
+#endif
+    if (id >= batch->sources->len)
+      break;
+    g_async_queue_push (batch->results,
+        gst_lrc_batch_process (batch, &parser, id));
+  }
+
+  gst_lrc_parser_clear (&parser);
+  return NULL;
+}
+
+/* Start parsing the sources added so far. */
+void
+gst_lrc_batch_start (GstLrcBatch * batch)
+{
+  guint i, n;
+
+  g_return_if_fail (batch->threads == NULL);
+
+  n = MIN (batch->n_threads, batch->sources->len);
+  batch->threads = g_new0 (GThread *, MAX (n, 1));
+
+  for (i = 0; i < n; i++) {
+    batch->threads[i] = gst_lrc_thread_new ("lrcbatch", gst_lrc_batch_worker,
+        batch);
+    if (!batch->threads[i])
+      break;
+  }
+  batch->n_running = i;
+
+  /* no thread at all, do the work here */
+  if (batch->n_running == 0)
+    gst_lrc_batch_worker (batch);
+
+  GST_DEBUG ("parsing %u sources on %u threads", batch->sources->len,
+      batch->n_running);
+}
+
+/* Wait for the next finished source, NULL once all were returned. */
+GstLrcBatchResult *
+gst_lrc_batch_next (GstLrcBatch * batch)
+{
+  g_return_val_if_fail (batch->threads != NULL, NULL);
+
+  if (batch->delivered == batch->sources->len)
+    return NULL;
+  batch->delivered++;
+
+  return g_async_queue_pop (batch->results);
+}
+
+void
+gst_lrc_batch_result_free (GstLrcBatchResult * result)
+{
+  if (result->index)
+    gst_lrc_index_unref (result->index);
+  if (result->error)
+    g_error_free (result->error);
+  g_free (result->path);
+  g_slice_free (GstLrcBatchResult, result);
+}
+
+/* Also stops a running batch: sources not yet started are skipped. */
+void
+gst_lrc_batch_free (GstLrcBatch * batch)
+{
+  GstLrcBatchResult *result;
+  guint i;
+
+  g_atomic_int_set (&batch->next, batch->sources->len);
+  for (i = 0; i < batch->n_running; i++)
+    g_thread_join (batch->threads[i]);
+  g_free (batch->threads);
+
+  while ((result = g_async_queue_try_pop (batch->results)))
+    gst_lrc_batch_result_free (result);
+  g_async_queue_unref (batch->results);
+
+  for (i = 0; i < batch->sources->len; i++)
+    g_free (g_array_index (batch->sources, GstLrcBatchSource, i).path);
+  g_array_free (batch->sources, TRUE);
+
+  g_slice_free (GstLrcBatch, batch);
+}
@@ -0,0 +1,72 @@
+/* GStreamer
+ * Copyright (C) <2008> Zhao Liang <zlweb@163.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+
+#ifndef __GST_LRC_BATCH_H__
+#define __GST_LRC_BATCH_H__
+
+#include <gst/gst.h>
+#include "gstlrcparse.h"
+
+G_BEGIN_DECLS
+
+/* Parses many lyrics files at once without a pipeline, for catalog
+ * ingest. Sources are files or blobs in memory; they are handed out to a
+ * pool of worker threads one at a time, so a slow file never holds up the
+ * others. Each worker runs its files through one parser, but the cue and
+ * text storage goes to the index of each file, so every file is parsed
+ * into fresh memory. Results come back in the order the files finish.
+ * Applications get it from the gstreamer-lrc-0.10 library, gst_init ()
+ * must have been called.
+ *
+ *   batch = gst_lrc_batch_new (0);
+ *   gst_lrc_batch_add_file (batch, path);
+ *   ...
+ *   gst_lrc_batch_start (batch);
+ *   while ((result = gst_lrc_batch_next (batch))) {
+ *     ...
+ *     gst_lrc_batch_result_free (result);
+ *   }
+ *   gst_lrc_batch_free (batch);
+ */
+
+typedef struct _GstLrcBatchResult {
+  guint          id;            /* order in which the source was added */
+  gchar         *path;          /* a copy, NULL for a blob */
+
+  /* the cues and tags, or NULL and an error */
+  GstLrcIndex   *index;
+  GError        *error;
+} GstLrcBatchResult;
+
+typedef struct _GstLrcBatch GstLrcBatch;
+
+GstLrcBatch *   gst_lrc_batch_new           (guint n_threads);
+void            gst_lrc_batch_free          (GstLrcBatch * batch);
+guint           gst_lrc_batch_add_file      (GstLrcBatch * batch,
+                                             const gchar * path);
+guint           gst_lrc_batch_add_data      (GstLrcBatch * batch,
+                                             const guint8 * data, gsize size);
+void            gst_lrc_batch_start         (GstLrcBatch * batch);
+GstLrcBatchResult * gst_lrc_batch_next      (GstLrcBatch * batch);
+void            gst_lrc_batch_result_free   (GstLrcBatchResult * result);
+
+G_END_DECLS
+
+#endif /* __GST_LRC_BATCH_H__ */
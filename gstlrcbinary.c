@@ -0,0 +1,261 @@
+/* GStreamer
+ * Copyright (C) <2008> Zhao Liang <zlweb@163.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <string.h>
+#include "gstlrcbinary.h"
+
+#define GST_CAT_DEFAULT lrcparse_debug
+
+#define LRC_BINARY_HEADER_CHECKSUM_OFFSET 44
+
+guint32
+gst_lrc_binary_adler32 (const guint8 * data, gsize size)
+{
+  guint32 a = 1, b = 0;
+  gsize n;
+
+  while (size > 0) {
+    /* largest block that can not overflow b */
+    n = MIN (size, 5552);
+    size -= n;
+    while (n--) {
+      a += *data++;
+      b += a;
+    }
+    a %= 65521;
+    b %= 65521;
+  }
+
+  return (b << 16) | a;
+}
+
+gboolean
+gst_lrc_binary_detect (const guint8 * data, gsize size)
+{
+  return size >= LRC_BINARY_HEADER_SIZE &&
+      memcmp (data, LRC_BINARY_MAGIC, 4) == 0;
+}
+
+/* section [offset, offset + size) lies within the buffer */
+#define LRC_BINARY_IN_RANGE(offset, size, total) \
+  ((guint64) (offset) + (guint64) (size) <= (guint64) (total))
+
+/* The metadata section holds the header tags as "name\0value\0" pairs,
+ * unknown names are skipped so that newer writers stay readable. The tags
+ * point into the section. */
+static void
+gst_lrc_binary_read_meta (GstLrcIndex * index, const guint8 * data,
+    gsize size)
+{
+  const gchar *p = (const gchar *) data;
+  const gchar *end = p + size;
+  const gchar *name, *value, *term;
+  gint tag;
+
+  while (p < end) {
+    name = p;
+    term = memchr (name, '\0', end - name);
+    if (!term)
+      break;
+    value = term + 1;
+    term = memchr (value, '\0', end - value);
+    if (!term)
+      break;
+    p = term + 1;
+
+    for (tag = 0; tag < GST_LRC_TAG_COUNT; tag++) {
+      if (strcmp (name, gst_lrc_tag_get_name (tag)) == 0) {
+        index->tags[tag] = (gchar *) value;
+        break;
+      }
+    }
+  }
+
+  if (index->tags[GST_LRC_TAG_OFFSET])
+    index->offset =
+        (gint) g_ascii_strtoll (index->tags[GST_LRC_TAG_OFFSET], NULL, 10);
+}
+
+/* Load an index straight from the data of buf without parsing it. On a
+ * little endian host the cue table is used in place, so the cost does not
+ * depend on the number of cues unless verify asks for the payload
+ * checksum. */
+GstLrcIndex *
+gst_lrc_binary_read (GstBuffer * buf, gboolean verify)
+{
+  const guint8 *data = GST_BUFFER_DATA (buf);
+  gsize size = GST_BUFFER_SIZE (buf);
+  GstLrcIndex *index;
+  GstLrcCue *cue;
+  guint32 n_cues, cues_offset, meta_offset, meta_size;
+  guint32 text_offset, text_size, header_size;
+  const guint8 *rec;
+  gboolean in_place;
+  gsize block_size;
+  guint i;
+
+  if (!gst_lrc_binary_detect (data, size))
+    return NULL;
+
+  if (GST_READ_UINT16_LE (data + 4) != LRC_BINARY_VERSION) {
+    GST_WARNING ("unsupported binary lyrics version %u",
+        GST_READ_UINT16_LE (data + 4));
+    return NULL;
+  }
+
+  header_size = GST_READ_UINT16_LE (data + 6);
+  if (header_size < LRC_BINARY_HEADER_SIZE || header_size > size ||
+      GST_READ_UINT32_LE (data + LRC_BINARY_HEADER_CHECKSUM_OFFSET) !=
+      gst_lrc_binary_adler32 (data, LRC_BINARY_HEADER_CHECKSUM_OFFSET)) {
+    GST_WARNING ("corrupt binary lyrics header");
+    return NULL;
+  }
+
+  n_cues = GST_READ_UINT32_LE (data + 12);
+  cues_offset = GST_READ_UINT32_LE (data + 16);
+  meta_offset = GST_READ_UINT32_LE (data + 20);
+  meta_size = GST_READ_UINT32_LE (data + 24);
+  text_offset = GST_READ_UINT32_LE (data + 28);
+  text_size = GST_READ_UINT32_LE (data + 32);
+
+  if (!LRC_BINARY_IN_RANGE (cues_offset,
+          (guint64) n_cues * LRC_BINARY_CUE_SIZE, size) ||
+      !LRC_BINARY_IN_RANGE (meta_offset, meta_size, size) ||
+      !LRC_BINARY_IN_RANGE (text_offset, text_size, size)) {
+    GST_WARNING ("binary lyrics sections out of range");
+    return NULL;
+  }
+
+  if (verify && GST_READ_UINT32_LE (data + 36) !=
+      gst_lrc_binary_adler32 (data + header_size, size - header_size)) {
+    GST_WARNING ("binary lyrics checksum mismatch");
+    return NULL;
+  }
+
+  /* one block for the struct and, if needed, a decoded copy of the cues */
+  in_place = FALSE;
+#if G_BYTE_ORDER == G_LITTLE_ENDIAN
+  in_place = sizeof (GstLrcCue) == LRC_BINARY_CUE_SIZE &&
+      ((gsize) (data + cues_offset) % sizeof (guint64)) == 0;
+#endif
+  block_size = GST_ROUND_UP_8 (sizeof (GstLrcIndex));
+  if (!in_place)
+    block_size += (gsize) n_cues * sizeof (GstLrcCue);
+
+  index = g_malloc (block_size);
+  index->refcount = 1;
+  index->n_cues = n_cues;
+  index->text = gst_buffer_create_sub (buf, text_offset, text_size);
+  memset (index->tags, 0, sizeof (index->tags));
+  index->offset = 0;
+  index->size = block_size + size;
+  index->mapping = gst_buffer_ref (buf);
+  gst_lrc_binary_read_meta (index, data + meta_offset, meta_size);
+
+  if (in_place) {
+    index->cues = (GstLrcCue *) (data + cues_offset);
+    return index;
+  }
+
+  index->cues = (GstLrcCue *) ((guint8 *) index +
+      GST_ROUND_UP_8 (sizeof (GstLrcIndex)));
+  rec = data + cues_offset;
+  for (i = 0; i < n_cues; i++, rec += LRC_BINARY_CUE_SIZE) {
+    cue = &index->cues[i];
+    cue->start = GST_READ_UINT64_LE (rec);
+    cue->stop = GST_READ_UINT64_LE (rec + 8);
+    cue->offset = GST_READ_UINT32_LE (rec + 16);
+    cue->length = GST_READ_UINT32_LE (rec + 20);
+  }
+
+  return index;
+}
+
+GstBuffer *
+gst_lrc_binary_write (const GstLrcIndex * index)
+{
+  GstBuffer *buf;
+  guint8 *data;
+  guint8 *rec;
+  guint32 cues_offset, meta_offset, meta_size, text_offset, text_size;
+  const gchar *name;
+  gsize len;
+  guint i;
+
+  cues_offset = LRC_BINARY_HEADER_SIZE;
+  meta_offset = cues_offset + index->n_cues * LRC_BINARY_CUE_SIZE;
+  meta_size = 0;
+  for (i = 0; i < GST_LRC_TAG_COUNT; i++) {
+    if (index->tags[i])
+      meta_size += strlen (gst_lrc_tag_get_name (i)) +
+          strlen (index->tags[i]) + 2;
+  }
+  text_offset = meta_offset + meta_size;
+  text_size = GST_BUFFER_SIZE (index->text);
+
+  buf = gst_buffer_new_and_alloc (text_offset + text_size);
+  data = GST_BUFFER_DATA (buf);
+  memset (data, 0, LRC_BINARY_HEADER_SIZE);
+
+  rec = data + cues_offset;
+  for (i = 0; i < index->n_cues; i++, rec += LRC_BINARY_CUE_SIZE) {
+    GST_WRITE_UINT64_LE (rec, index->cues[i].start);
+    GST_WRITE_UINT64_LE (rec + 8, index->cues[i].stop);
+    GST_WRITE_UINT32_LE (rec + 16, index->cues[i].offset);
+    GST_WRITE_UINT32_LE (rec + 20, index->cues[i].length);
+  }
+
+  rec = data + meta_offset;
+  for (i = 0; i < GST_LRC_TAG_COUNT; i++) {
+    if (!index->tags[i])
+      continue;
+    name = gst_lrc_tag_get_name (i);
+    len = strlen (name) + 1;
+    memcpy (rec, name, len);
+    rec += len;
+    len = strlen (index->tags[i]) + 1;
+    memcpy (rec, index->tags[i], len);
+    rec += len;
+  }
+
+  memcpy (data + text_offset, GST_BUFFER_DATA (index->text), text_size);
+
+  memcpy (data, LRC_BINARY_MAGIC, 4);
+  GST_WRITE_UINT16_LE (data + 4, LRC_BINARY_VERSION);
+  GST_WRITE_UINT16_LE (data + 6, LRC_BINARY_HEADER_SIZE);
+  GST_WRITE_UINT32_LE (data + 8, 0);
+  GST_WRITE_UINT32_LE (data + 12, index->n_cues);
+  GST_WRITE_UINT32_LE (data + 16, cues_offset);
+  GST_WRITE_UINT32_LE (data + 20, meta_offset);
+  GST_WRITE_UINT32_LE (data + 24, meta_size);
+  GST_WRITE_UINT32_LE (data + 28, text_offset);
+  GST_WRITE_UINT32_LE (data + 32, text_size);
+  GST_WRITE_UINT32_LE (data + 36,
+      gst_lrc_binary_adler32 (data + LRC_BINARY_HEADER_SIZE,
+          GST_BUFFER_SIZE (buf) - LRC_BINARY_HEADER_SIZE));
+  GST_WRITE_UINT32_LE (data + LRC_BINARY_HEADER_CHECKSUM_OFFSET,
+      gst_lrc_binary_adler32 (data, LRC_BINARY_HEADER_CHECKSUM_OFFSET));
+
+  return buf;
+}
@@ -0,0 +1,58 @@
+/* GStreamer
+ * Copyright (C) <2008> Zhao Liang <zlweb@163.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifndef __GST_LRC_BINARY_H__
+#define __GST_LRC_BINARY_H__
+
+#include <gst/gst.h>
+#include "gstlrcparse.h"
+
+G_BEGIN_DECLS
+
+/* Precompiled lyrics, written once by lrcindexenc and loaded by lrcdemux
+ * without parsing. All fields are little endian:
+ *
+ *   0  "LRCI"
+ *   4  guint16 version, guint16 header size
+ *   8  guint32 flags, n_cues, cues offset, meta offset, meta size,
+ *      text offset, text size, payload checksum, reserved,
+ *      header checksum
+ *  48  cue table, n_cues records of guint64 start, guint64 stop,
+ *      guint32 text offset, guint32 text length
+ *      metadata, "key\0value\0" pairs
+ *      text block, every cue text followed by a '\0'
+ *
+ * Both checksums are Adler-32, the header one covers the first 44 bytes,
+ * the payload one everything after the header. */
+
+#define LRC_BINARY_MAGIC        "LRCI"
+#define LRC_BINARY_VERSION      1
+#define LRC_BINARY_HEADER_SIZE  48
+#define LRC_BINARY_CUE_SIZE     24
+
+#define LRC_BINARY_CAPS         "application/x-lrc-index"
+
+gboolean        gst_lrc_binary_detect       (const guint8 * data, gsize size);
+GstLrcIndex *   gst_lrc_binary_read         (GstBuffer * buf, gboolean verify);
+GstBuffer *     gst_lrc_binary_write        (const GstLrcIndex * index);
+guint32         gst_lrc_binary_adler32      (const guint8 * data, gsize size);
+
+G_END_DECLS
+
+#endif /* __GST_LRC_BINARY_H__ */
@@ -0,0 +1,167 @@
+/* GStreamer
+ * Copyright (C) <2008> Zhao Liang <zlweb@163.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <string.h>
+#include "gstlrccache.h"
+
+typedef struct _GstLrcCacheEntry {
+  gchar         *key;
+  GstLrcIndex   *index;
+  gsize          size;
+  GList         *link;
+} GstLrcCacheEntry;
+
+/* a static GMutex needs no setup from GLib 2.32 on, which deprecates
+ * GStaticMutex */
+#if GLIB_CHECK_VERSION (2, 32, 0)
+static GMutex cache_lock;
+#define LRC_CACHE_LOCK() g_mutex_lock (&cache_lock)
+#define LRC_CACHE_UNLOCK() g_mutex_unlock (&cache_lock)
+#else
+static GStaticMutex cache_lock = G_STATIC_MUTEX_INIT;
+#define LRC_CACHE_LOCK() g_static_mutex_lock (&cache_lock)
+#define LRC_CACHE_UNLOCK() g_static_mutex_unlock (&cache_lock)
+#endif
+
+/* all protected by cache_lock */
+static GHashTable *cache_table = NULL;
+static GQueue cache_lru = { NULL, NULL, 0 };
+static guint64 cache_bytes = 0;
+static guint64 cache_budget = LRC_CACHE_DEFAULT_BUDGET;
+static guint64 cache_hits = 0;
+static guint64 cache_misses = 0;
+
+static void
+gst_lrc_cache_entry_free (GstLrcCacheEntry * entry)
+{
+  gst_lrc_index_unref (entry->index);
+  g_free (entry->key);
+  g_slice_free (GstLrcCacheEntry, entry);
+}
+
+/* drop least recently used entries until the budget is met */
+static void
+gst_lrc_cache_evict_unlocked (guint64 budget)
+{
+  GstLrcCacheEntry *entry;
+
+  while (cache_bytes > budget && (entry = g_queue_pop_tail (&cache_lru))) {
+    cache_bytes -= entry->size;
+    g_hash_table_remove (cache_table, entry->key);
+    gst_lrc_cache_entry_free (entry);
+  }
+}
+
+/* returns a new reference to the cached index or NULL */
+GstLrcIndex *
+gst_lrc_cache_lookup (const gchar * key)
+{
+  GstLrcCacheEntry *entry = NULL;
+  GstLrcIndex *index = NULL;
+
+  LRC_CACHE_LOCK ();
+  if (cache_table)
+    entry = g_hash_table_lookup (cache_table, key);
+
+  if (entry) {
+    /* move to the front of the LRU list */
+    g_queue_unlink (&cache_lru, entry->link);
+    g_queue_push_head_link (&cache_lru, entry->link);
+    index = gst_lrc_index_ref (entry->index);
+    cache_hits++;
+  } else {
+    cache_misses++;
+  }
+  LRC_CACHE_UNLOCK ();
+
+  return index;
+}
+
+void
+gst_lrc_cache_insert (const gchar * key, GstLrcIndex * index)
+{
+  GstLrcCacheEntry *entry;
+  gsize size;
+
+  size = gst_lrc_index_get_size (index) + strlen (key);
+
+  LRC_CACHE_LOCK ();
+  if (size > cache_budget)
+    goto done;
+
+  if (!cache_table)
+    cache_table = g_hash_table_new (g_str_hash, g_str_equal);
+
+  /* somebody else parsed the same file meanwhile */
+  if (g_hash_table_lookup (cache_table, key))
+    goto done;
+
+  gst_lrc_cache_evict_unlocked (cache_budget - size);
+
+  entry = g_slice_new (GstLrcCacheEntry);
+  entry->key = g_strdup (key);
+  entry->index = gst_lrc_index_ref (index);
+  entry->size = size;
+  g_queue_push_head (&cache_lru, entry);
+  entry->link = cache_lru.head;
+  g_hash_table_insert (cache_table, entry->key, entry);
+  cache_bytes += size;
+
+done:
+  LRC_CACHE_UNLOCK ();
+}
+
+void
+gst_lrc_cache_set_budget (guint64 bytes)
+{
+  LRC_CACHE_LOCK ();
+  cache_budget = bytes;
+  gst_lrc_cache_evict_unlocked (bytes);
+  LRC_CACHE_UNLOCK ();
+}
+
+guint64
+gst_lrc_cache_get_budget (void)
+{
+  guint64 budget;
+
+  LRC_CACHE_LOCK ();
+  budget = cache_budget;
+  LRC_CACHE_UNLOCK ();
+
+  return budget;
+}
+
+void
+gst_lrc_cache_get_stats (guint64 * hits, guint64 * misses, guint64 * bytes)
+{
+  LRC_CACHE_LOCK ();
+  if (hits)
+    *hits = cache_hits;
+  if (misses)
+    *misses = cache_misses;
+  if (bytes)
+    *bytes = cache_bytes;
+  LRC_CACHE_UNLOCK ();
+}
@@ -0,0 +1,46 @@
+/* GStreamer
+ * Copyright (C) <2008> Zhao Liang <zlweb@163.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifndef __GST_LRC_CACHE_H__
+#define __GST_LRC_CACHE_H__
+
+#include <gst/gst.h>
+#include "gstlrcparse.h"
+
+G_BEGIN_DECLS
+
+/* Process wide cache of parsed lyrics, shared by all lrcdemux instances.
+ * Entries are looked up by a key describing the source (uri, size and
+ * mtime of a local file, or a content hash) and evicted in LRU order once
+ * the byte budget is exceeded. */
+
+#define LRC_CACHE_DEFAULT_BUDGET (4 * 1024 * 1024)
+
+GstLrcIndex *   gst_lrc_cache_lookup        (const gchar * key);
+void            gst_lrc_cache_insert        (const gchar * key,
+                                             GstLrcIndex * index);
+
+void            gst_lrc_cache_set_budget    (guint64 bytes);
+guint64         gst_lrc_cache_get_budget    (void);
+void            gst_lrc_cache_get_stats     (guint64 * hits, guint64 * misses,
+                                             guint64 * bytes);
+
+G_END_DECLS
+
+#endif /* __GST_LRC_CACHE_H__ */
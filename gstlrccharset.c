@@ -0,0 +1,560 @@
+/* GStreamer
+ * Copyright (C) <2008> Zhao Liang <zlweb@163.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <errno.h>
+#include <string.h>
+#include "gstlrccharset.h"
+#include "gstlrcparse.h"
+
+#define GST_CAT_DEFAULT lrcparse_debug
+
+#define LRC_REPLACEMENT "\xef\xbf\xbd"
+
+/* bytes from the first non-ascii one the guess is made on */
+#define LRC_GUESS_SIZE 256
+
+/* longest input sequence of the supported encodings, a UTF-16 pair */
+#define LRC_CARRY_MAX 8
+
+/* Length of the leading ascii run of data, tested a word at a time. Tags,
+ * timestamps and line ends are ascii, so this covers much of any file. */
+static gsize
+gst_lrc_ascii_span (const guint8 * data, gsize size)
+{
+  guint64 word;
+  gsize pos = 0;
+
+  for (; pos + 8 <= size; pos += 8) {
+    memcpy (&word, data + pos, 8);
+    if (word & G_GUINT64_CONSTANT (0x8080808080808080))
+      break;
+  }
+  while (pos < size && data[pos] < 0x80)
+    pos++;
+
+  return pos;
+}
+
+/* Check the UTF-8 sequence at data, without overlong forms, surrogates
+ * and code points above U+10FFFF. Returns its length, or 0 if it is
+ * invalid or cut by the end of data; missing is then the number of bytes
+ * still needed for a valid prefix. */
+static guint
+gst_lrc_utf8_check (const guint8 * data, gsize size, guint * missing)
+{
+  guint8 lead = data[0];
+  guint8 lo = 0x80, hi = 0xbf;
+  guint len, i;
+
+  *missing = 0;
+
+  if (lead >= 0xc2 && lead <= 0xdf)
+    len = 2;
+  else if (lead >= 0xe0 && lead <= 0xef)
+    len = 3;
+  else if (lead >= 0xf0 && lead <= 0xf4)
+    len = 4;
+  else
+    return 0;
+
+  if (lead == 0xe0)
+    lo = 0xa0;
+  else if (lead == 0xed)
+    hi = 0x9f;
+  else if (lead == 0xf0)
+    lo = 0x90;
+  else if (lead == 0xf4)
+    hi = 0x8f;
+
+  for (i = 1; i < len; i++) {
+    if (i == size) {
+      *missing = len - i;
+      return 0;
+    }
+    if (data[i] < lo || data[i] > hi)
+      return 0;
+    lo = 0x80;
+    hi = 0xbf;
+  }
+
+  return len;
+}
+
+/* Length of the invalid sequence at data: the lead byte and the bytes
+ * after it that still made a valid prefix, all replaced by one U+FFFD. */
+static guint
+gst_lrc_utf8_invalid_length (const guint8 * data, gsize size)
+{
+  guint len = 1;
+  guint missing;
+
+  while (len < size && gst_lrc_utf8_check (data, len + 1, &missing) == 0 &&
+      missing > 0)
+    len++;
+
+  return len;
+}
+
+/* length of the valid UTF-8 at the start of data */
+static gsize
+gst_lrc_utf8_span (const guint8 * data, gsize size, guint * missing)
+{
+  gsize pos = 0;
+  guint len;
+
+  *missing = 0;
+  for (;;) {
+    pos += gst_lrc_ascii_span (data + pos, size - pos);
+    if (pos == size)
+      return pos;
+    len = gst_lrc_utf8_check (data + pos, size - pos, missing);
+    if (len == 0)
+      return pos;
+    pos += len;
+  }
+}
+
+/* Tell UTF-8 from the double byte encodings. GBK leads run from 0x81,
+ * Big5 ones from 0xa1 to 0xf9 with trails 0x40-0x7e and 0xa1-0xfe, so
+ * bytes outside that settle it for GBK. Otherwise Big5 shows in the many
+ * low trails, the common GB2312 characters all have trails from 0xa1. */
+static const gchar *
+gst_lrc_guess_charset (const guint8 * data, gsize size)
+{
+  guint pairs = 0, low = 0;
+  guint8 lead, trail;
+  guint missing;
+  gsize i;
+
+  if (gst_lrc_utf8_span (data, size, &missing) == size || missing > 0)
+    return "UTF-8";
+
+  for (i = 0; i + 1 < size; i++) {
+    lead = data[i];
+    if (lead < 0x80)
+      continue;
+    trail = data[++i];
+    if (lead < 0xa1 || lead > 0xf9 || (trail >= 0x80 && trail < 0xa1) ||
+        trail == 0xff)
+      return "GBK";
+    pairs++;
+    if (trail >= 0x40 && trail <= 0x7e)
+      low++;
+  }
+
+  return low * 8 > pairs ? "BIG5" : "GBK";
+}
+
+static void
+gst_lrc_converter_set_charset (GstLrcConverter * conv, const gchar * charset)
+{
+  if (conv->iconv != (GIConv) - 1) {
+    g_iconv_close (conv->iconv);
+    conv->iconv = (GIConv) - 1;
+  }
+  g_free (conv->charset);
+  conv->charset = g_strdup (charset);
+  conv->detected = TRUE;
+  conv->wide = g_ascii_strncasecmp (charset, "UTF-16", 6) == 0 ||
+      g_ascii_strncasecmp (charset, "UTF-32", 6) == 0 ||
+      g_ascii_strncasecmp (charset, "UCS-", 4) == 0;
+
+  if (g_ascii_strcasecmp (charset, "UTF-8") == 0 ||
+      g_ascii_strcasecmp (charset, "UTF8") == 0)
+    return;
+
+  conv->iconv = g_iconv_open ("UTF-8", charset);
+  if (conv->iconv == (GIConv) - 1) {
+    GST_WARNING ("no conversion from %s, taking the lyrics as UTF-8",
+        charset);
+    conv->wide = FALSE;
+  } else {
+    GST_DEBUG ("converting lyrics from %s", charset);
+  }
+}
+
+/* A byte order mark wins over the charset property and is dropped.
+ * Without one, UTF-16 still shows in the zero byte next to the '[' the
+ * first line starts with. Returns the size of the mark. */
+static gsize
+gst_lrc_converter_start (GstLrcConverter * conv, const guint8 * data,
+    gsize size)
+{
+  const gchar *charset = NULL;
+  gsize skip = 0;
+
+  conv->started = TRUE;
+
+  if (size >= 3 && data[0] == 0xef && data[1] == 0xbb && data[2] == 0xbf) {
+    charset = "UTF-8";
+    skip = 3;
+  } else if (size >= 2 && data[0] == 0xff && data[1] == 0xfe) {
+    charset = "UTF-16LE";
+    skip = 2;
+  } else if (size >= 2 && data[0] == 0xfe && data[1] == 0xff) {
+    charset = "UTF-16BE";
+    skip = 2;
+  } else if (!conv->detected && size >= 2 && data[0] == '[' && data[1] == 0) {
+    charset = "UTF-16LE";
+  } else if (!conv->detected && size >= 2 && data[0] == 0 && data[1] == '[') {
+    charset = "UTF-16BE";
+  }
+
+  if (charset)
+    gst_lrc_converter_set_charset (conv, charset);
+  return skip;
+}
+
+static const gchar *
+gst_lrc_converter_output (GstLrcConverter * conv, gsize * outlen)
+{
+  *outlen = conv->out->len;
+  return *outlen > 0 ? (const gchar *) conv->out->data : "";
+}
+
+/* Pass valid UTF-8 through in place. A sequence cut by the end of the
+ * buffer is held back in carry and completed from the next one. Only
+ * invalid bytes, or a completed sequence, make a copy, with one U+FFFD in
+ * place of each invalid sequence. */
+static const gchar *
+gst_lrc_converter_check_utf8 (GstLrcConverter * conv, const guint8 * data,
+    gsize size, gsize * outlen)
+{
+  GByteArray *out = conv->out;
+  GByteArray *carry = conv->carry;
+  gboolean copy = FALSE;
+  gsize pos = 0, start, end;
+  guint missing;
+
+  /* complete the sequence cut by the last buffer a byte at a time, the
+   * byte that does not fit it starts over */
+  if (carry->len > 0) {
+    g_byte_array_set_size (out, 0);
+    copy = TRUE;
+  }
+  while (carry->len > 0 && pos < size) {
+    g_byte_array_append (carry, data + pos, 1);
+    if (gst_lrc_utf8_check (carry->data, carry->len, &missing) > 0) {
+      g_byte_array_append (out, carry->data, carry->len);
+      g_byte_array_set_size (carry, 0);
+      pos++;
+    } else if (missing == 0) {
+      g_byte_array_append (out, (const guint8 *) LRC_REPLACEMENT, 3);
+      g_byte_array_set_size (carry, 0);
+    } else {
+      pos++;
+    }
+  }
+
+  start = pos;
+  end = size;
+  for (;;) {
+    pos += gst_lrc_utf8_span (data + pos, size - pos, &missing);
+    if (pos == size)
+      break;
+    if (missing > 0) {
+      g_byte_array_append (carry, data + pos, size - pos);
+      end = pos;
+      break;
+    }
+    if (!copy) {
+      g_byte_array_set_size (out, 0);
+      copy = TRUE;
+    }
+    g_byte_array_append (out, data + start, pos - start);
+    g_byte_array_append (out, (const guint8 *) LRC_REPLACEMENT, 3);
+    pos += gst_lrc_utf8_invalid_length (data + pos, size - pos);
+    start = pos;
+  }
+
+  if (!copy) {
+    *outlen = end;
+    return (const gchar *) data;
+  }
+  g_byte_array_append (out, data + start, end - start);
+  return gst_lrc_converter_output (conv, outlen);
+}
+
+/* Convert as much of data as possible onto the output. Stops before a
+ * sequence cut by the end of data, returns the number of bytes used. */
+static gsize
+gst_lrc_converter_run (GstLrcConverter * conv, const guint8 * data,
+    gsize size)
+{
+  GByteArray *out = conv->out;
+  gchar *inbuf = (gchar *) data;
+  gchar *outbuf;
+  gsize inleft = size;
+  gsize outleft;
+  gsize len, skip;
+
+  while (inleft > 0) {
+    len = out->len;
+    g_byte_array_set_size (out, len + inleft * 2 + 16);
+    outbuf = (gchar *) out->data + len;
+    outleft = out->len - len;
+
+    len = g_iconv (conv->iconv, &inbuf, &inleft, &outbuf, &outleft);
+    g_byte_array_set_size (out, outbuf - (gchar *) out->data);
+    if (len != (gsize) - 1 || errno == EINVAL)
+      break;
+
+    if (errno == EILSEQ) {
+      g_byte_array_append (out, (const guint8 *) LRC_REPLACEMENT, 3);
+      skip = MIN (inleft, conv->wide ? 2 : 1);
+      inbuf += skip;
+      inleft -= skip;
+    } else if (errno != E2BIG) {
+      GST_WARNING ("conversion from %s failed: %s", conv->charset,
+          g_strerror (errno));
+      break;
+    }
+  }
+
+  return size - inleft;
+}
+
+static const gchar *
+gst_lrc_converter_iconv (GstLrcConverter * conv, const guint8 * data,
+    gsize size, gsize * outlen)
+{
+  GByteArray *carry = conv->carry;
+  gsize used;
+
+  g_byte_array_set_size (conv->out, 0);
+
+  /* complete the sequence cut by the last buffer a byte at a time */
+  while (carry->len > 0 && size > 0) {
+    g_byte_array_append (carry, data, 1);
+    data++;
+    size--;
+    used = gst_lrc_converter_run (conv, carry->data, carry->len);
+    g_byte_array_remove_range (carry, 0, used);
+    if (carry->len >= LRC_CARRY_MAX) {
+      g_byte_array_append (conv->out, (const guint8 *) LRC_REPLACEMENT, 3);
+      g_byte_array_set_size (carry, 0);
+    }
+  }
+
+  used = gst_lrc_converter_run (conv, data, size);
+  g_byte_array_append (carry, data + used, size - used);
+
+  return gst_lrc_converter_output (conv, outlen);
+}
+
+static const gchar *
+gst_lrc_converter_process (GstLrcConverter * conv, const guint8 * data,
+    gsize size, gsize * outlen)
+{
+  if (conv->iconv == (GIConv) - 1)
+    return gst_lrc_converter_check_utf8 (conv, data, size, outlen);
+
+  /* ascii needs no conversion in the double byte encodings */
+  if (!conv->wide && conv->carry->len == 0 &&
+      gst_lrc_ascii_span (data, size) == size) {
+    *outlen = size;
+    return (const gchar *) data;
+  }
+
+  return gst_lrc_converter_iconv (conv, data, size, outlen);
+}
+
+/* Decide on the charset once the held back start of the file is long
+ * enough, or at its end, and convert what was held back. The result is
+ * always in the output array. */
+static const gchar *
+gst_lrc_converter_decide (GstLrcConverter * conv, gboolean last,
+    gsize * outlen)
+{
+  GByteArray *head = conv->head;
+  const gchar *res;
+  gsize ascii, len;
+
+  if (!conv->started) {
+    if (head->len < 3 && !last)
+      goto wait;
+    g_byte_array_remove_range (head, 0,
+        gst_lrc_converter_start (conv, head->data, head->len));
+  }
+
+  if (!conv->detected) {
+    ascii = gst_lrc_ascii_span (head->data, head->len);
+    if (ascii < head->len) {
+      if (head->len - ascii < LRC_GUESS_SIZE && !last)
+        goto wait;
+      gst_lrc_converter_set_charset (conv,
+          gst_lrc_guess_charset (head->data + ascii, head->len - ascii));
+    }
+  }
+
+  if (conv->detected) {
+    res = gst_lrc_converter_process (conv, head->data, head->len, &len);
+  } else {
+    res = (const gchar *) head->data;
+    len = head->len;
+  }
+  if (res != (const gchar *) conv->out->data) {
+    g_byte_array_set_size (conv->out, 0);
+    g_byte_array_append (conv->out, (const guint8 *) res, len);
+  }
+  g_byte_array_set_size (head, 0);
+
+  return gst_lrc_converter_output (conv, outlen);
+
+wait:
+  *outlen = 0;
+  return "";
+}
+
+/* charset is the value of the charset property, NULL to detect it */
+void
+gst_lrc_converter_init (GstLrcConverter * conv, const gchar * charset)
+{
+  conv->charset = NULL;
+  conv->iconv = (GIConv) - 1;
+  conv->wide = FALSE;
+  conv->started = FALSE;
+  conv->detected = FALSE;
+  conv->out = g_byte_array_new ();
+  conv->carry = g_byte_array_new ();
+  conv->head = g_byte_array_new ();
+
+  if (charset && *charset)
+    gst_lrc_converter_set_charset (conv, charset);
+}
+
+void
+gst_lrc_converter_clear (GstLrcConverter * conv)
+{
+  if (conv->iconv != (GIConv) - 1)
+    g_iconv_close (conv->iconv);
+  conv->iconv = (GIConv) - 1;
+  g_free (conv->charset);
+  conv->charset = NULL;
+  g_byte_array_free (conv->out, TRUE);
+  conv->out = NULL;
+  g_byte_array_free (conv->carry, TRUE);
+  conv->carry = NULL;
+  g_byte_array_free (conv->head, TRUE);
+  conv->head = NULL;
+}
+
+/* For a converter of data from the middle of a file: no byte order mark
+ * is looked for, the charset is the one given to init. */
+void
+gst_lrc_converter_skip_start (GstLrcConverter * conv)
+{
+  conv->started = TRUE;
+}
+
+/* Forget what was converted so far but keep the charset, for converting
+ * pieces of one file that do not follow each other. */
+void
+gst_lrc_converter_reset (GstLrcConverter * conv)
+{
+  if (conv->iconv != (GIConv) - 1)
+    g_iconv (conv->iconv, NULL, NULL, NULL, NULL);
+  g_byte_array_set_size (conv->carry, 0);
+  g_byte_array_set_size (conv->head, 0);
+}
+
+/* Convert the next buffer of the file. The result is data itself or the
+ * converter's output, valid until the next call. */
+const gchar *
+gst_lrc_converter_convert (GstLrcConverter * conv, const gchar * data,
+    gsize size, gsize * outlen)
+{
+  const guint8 *in = (const guint8 *) data;
+
+  gsize ascii;
+
+  /* decide on this buffer if it is long enough, the whole file is one
+   * buffer in pull mode */
+  if (conv->head->len == 0 && (conv->started || size >= 3)) {
+    if (!conv->started) {
+      ascii = gst_lrc_converter_start (conv, in, size);
+      in += ascii;
+      size -= ascii;
+    }
+    if (!conv->detected) {
+      ascii = gst_lrc_ascii_span (in, size);
+      /* ascii reads the same in all candidates */
+      if (ascii == size) {
+        *outlen = size;
+        return (const gchar *) in;
+      }
+      if (size - ascii >= LRC_GUESS_SIZE)
+        gst_lrc_converter_set_charset (conv,
+            gst_lrc_guess_charset (in + ascii, size - ascii));
+    }
+    if (conv->detected)
+      return gst_lrc_converter_process (conv, in, size, outlen);
+  }
+
+  g_byte_array_append (conv->head, in, size);
+  return gst_lrc_converter_decide (conv, FALSE, outlen);
+}
+
+/* At the end of the file, a sequence still cut becomes U+FFFD. */
+const gchar *
+gst_lrc_converter_finish (GstLrcConverter * conv, gsize * outlen)
+{
+  gsize len;
+
+  if (conv->head->len > 0)
+    gst_lrc_converter_decide (conv, TRUE, &len);
+  else
+    g_byte_array_set_size (conv->out, 0);
+  if (conv->carry->len > 0) {
+    g_byte_array_append (conv->out, (const guint8 *) LRC_REPLACEMENT, 3);
+    g_byte_array_set_size (conv->carry, 0);
+  }
+
+  return gst_lrc_converter_output (conv, outlen);
+}
+
+/* Convert a whole file given as one buffer. */
+const gchar *
+gst_lrc_converter_convert_all (GstLrcConverter * conv, const gchar * data,
+    gsize size, gsize * outlen)
+{
+  const gchar *res = gst_lrc_converter_convert (conv, data, size, outlen);
+
+  /* too short to decide, all of it was held back */
+  if (conv->head->len > 0)
+    return gst_lrc_converter_finish (conv, outlen);
+
+  /* a sequence cut by the end, the text before it may be in place */
+  if (conv->carry->len > 0) {
+    if (*outlen == 0 || res != (const gchar *) conv->out->data) {
+      g_byte_array_set_size (conv->out, 0);
+      g_byte_array_append (conv->out, (const guint8 *) res, *outlen);
+    }
+    g_byte_array_append (conv->out, (const guint8 *) LRC_REPLACEMENT, 3);
+    g_byte_array_set_size (conv->carry, 0);
+    return gst_lrc_converter_output (conv, outlen);
+  }
+
+  return res;
+}
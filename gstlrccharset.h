@@ -0,0 +1,64 @@
+/* GStreamer
+ * Copyright (C) <2008> Zhao Liang <zlweb@163.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+
+#ifndef __GST_LRC_CHARSET_H__
+#define __GST_LRC_CHARSET_H__
+
+#include <gst/gst.h>
+
+G_BEGIN_DECLS
+
+/* Streaming conversion of lyrics to UTF-8, done once in lrcdemux so that
+ * the cues carry UTF-8 text. The encoding is taken from the charset
+ * property, a byte order mark or a guess between UTF-8, GBK and Big5 from
+ * the first non-ascii bytes, which are held back until there are enough.
+ * Valid UTF-8 and ascii are only validated and returned in place; other
+ * encodings go through g_iconv. In both cases a sequence split between
+ * buffers is held back until the rest arrives. Invalid bytes, and a
+ * sequence still cut at the end of the file, become U+FFFD. */
+typedef struct _GstLrcConverter {
+  gchar         *charset;       /* NULL until known */
+  GIConv         iconv;         /* (GIConv) -1 for UTF-8 */
+  gboolean       wide;          /* UTF-16 and the like, ascii is not as is */
+  gboolean       started;       /* byte order mark checked */
+  gboolean       detected;
+
+  GByteArray    *out;
+  GByteArray    *carry;         /* sequence cut by the end of the input */
+  GByteArray    *head;          /* held back until the charset is known */
+} GstLrcConverter;
+
+void            gst_lrc_converter_init      (GstLrcConverter * conv,
+                                             const gchar * charset);
+void            gst_lrc_converter_clear     (GstLrcConverter * conv);
+void            gst_lrc_converter_skip_start (GstLrcConverter * conv);
+void            gst_lrc_converter_reset     (GstLrcConverter * conv);
+const gchar *   gst_lrc_converter_convert   (GstLrcConverter * conv,
+                                             const gchar * data, gsize size,
+                                             gsize * outlen);
+const gchar *   gst_lrc_converter_finish    (GstLrcConverter * conv,
+                                             gsize * outlen);
+const gchar *   gst_lrc_converter_convert_all (GstLrcConverter * conv,
+                                             const gchar * data, gsize size,
+                                             gsize * outlen);
+
+G_END_DECLS
+
+#endif /* __GST_LRC_CHARSET_H__ */
@@ -48,11 +48,39 @@
 #endif
 
 #include <string.h>
+#include <glib/gstdio.h>
+#include <gst/base/gstadapter.h>
 #include "gstlrcdemux.h"
+#include "gstlrccache.h"
+#include "gstlrcbinary.h"
 
 GST_DEBUG_CATEGORY_STATIC (lrcdemux_debug);
 #define GST_CAT_DEFAULT lrcdemux_debug
 
+
+enum
+{
+  PROP_0,
+  PROP_USE_CACHE,
+  PROP_CACHE_SIZE,
+  PROP_CACHE_HITS,
+  PROP_CACHE_MISSES,
+  PROP_PROBE,
+  PROP_CHARSET,
+  PROP_PARSE_THREADS,
+  PROP_LAZY_TEXT,
+  PROP_TITLE,
+  PROP_ARTIST,
+  PROP_ALBUM,
+  PROP_CREATOR,
+  PROP_OFFSET
+};
+
+#define DEFAULT_USE_CACHE FALSE
+#define DEFAULT_PROBE FALSE
+#define DEFAULT_PARSE_THREADS 1
+#define DEFAULT_LAZY_TEXT FALSE
+
 static GstStaticPadTemplate srctemplate = GST_STATIC_PAD_TEMPLATE ("src",
     GST_PAD_SRC,
     GST_PAD_ALWAYS,
@@ -62,13 +90,17 @@ static GstStaticPadTemplate srctemplate = GST_STATIC_PAD_TEMPLATE ("src",
 static GstStaticPadTemplate sinktemplate = GST_STATIC_PAD_TEMPLATE ("sink",
     GST_PAD_SINK,
     GST_PAD_ALWAYS,
-    GST_STATIC_CAPS_ANY
+    GST_STATIC_CAPS (LRC_CAPS "; " LRC_BINARY_CAPS)
     );
 
 static void gst_lrc_demux_base_init (GstLrcDemuxClass * klass);
 static void gst_lrc_demux_class_init (GstLrcDemuxClass * klass);
 static void gst_lrc_demux_init (GstLrcDemux * lrc, GstLrcDemuxClass * gclass);
 static void gst_lrc_demux_finalize (GObject * object);
+static void gst_lrc_demux_set_property (GObject * object, guint prop_id,
+    const GValue * value, GParamSpec * pspec);
+static void gst_lrc_demux_get_property (GObject * object, guint prop_id,
+    GValue * value, GParamSpec * pspec);
 
 
 static void gst_lrc_demux_loop (GstPad * pad);
@@ -76,6 +108,9 @@ static gboolean gst_lrc_demux_sink_activate (GstPad * sinkpad);
 static gboolean gst_lrc_demux_sink_activate_pull (GstPad * sinkpad,
     gboolean active);
 static GstFlowReturn gst_lrc_demux_chain (GstPad * pad, GstBuffer * buf);
+static gboolean gst_lrc_demux_sink_event (GstPad * pad, GstEvent * event);
+static gboolean gst_lrc_demux_src_event (GstPad * pad, GstEvent * event);
+static gboolean gst_lrc_demux_src_query (GstPad * pad, GstQuery * query);
 
 static GstStateChangeReturn gst_lrc_demux_change_state (GstElement * element,
     GstStateChange transition);
@@ -140,6 +175,61 @@ gst_lrc_demux_class_init (GstLrcDemuxClass * klass)
       gst_static_pad_template_get (&sinktemplate));
   
   gobject_class->finalize = gst_lrc_demux_finalize;
+  gobject_class->set_property = gst_lrc_demux_set_property;
+  gobject_class->get_property = gst_lrc_demux_get_property;
+
+  g_object_class_install_property (gobject_class, PROP_USE_CACHE,
+      g_param_spec_boolean ("use-cache", "Use cache",
+          "Share parsed lyrics with other instances through the process "
+          "wide cache", DEFAULT_USE_CACHE, G_PARAM_READWRITE));
+  g_object_class_install_property (gobject_class, PROP_CACHE_SIZE,
+      g_param_spec_uint64 ("cache-size", "Cache size",
+          "Byte budget of the process wide cache, shared by all instances",
+          0, G_MAXUINT64, LRC_CACHE_DEFAULT_BUDGET, G_PARAM_READWRITE));
+  g_object_class_install_property (gobject_class, PROP_CACHE_HITS,
+      g_param_spec_uint64 ("cache-hits", "Cache hits",
+          "Number of lookups the process wide cache could answer",
+          0, G_MAXUINT64, 0, G_PARAM_READABLE));
+  g_object_class_install_property (gobject_class, PROP_CACHE_MISSES,
+      g_param_spec_uint64 ("cache-misses", "Cache misses",
+          "Number of lookups that had to parse the file",
+          0, G_MAXUINT64, 0, G_PARAM_READABLE));
+  g_object_class_install_property (gobject_class, PROP_PROBE,
+      g_param_spec_boolean ("probe", "Probe",
+          "Only read the header up to the first timestamped line and send "
+          "its tags, no cues are pushed", DEFAULT_PROBE, G_PARAM_READWRITE));
+  g_object_class_install_property (gobject_class, PROP_CHARSET,
+      g_param_spec_string ("charset", "Character set",
+          "Encoding of the lyrics, converted to UTF-8. Detected from a byte "
+          "order mark or the text when not set", NULL, G_PARAM_READWRITE));
+  g_object_class_install_property (gobject_class, PROP_PARSE_THREADS,
+      g_param_spec_uint ("parse-threads", "Parse threads",
+          "Threads parsing a large file in chunks, 0 for one per processor",
+          0, G_MAXUINT, DEFAULT_PARSE_THREADS, G_PARAM_READWRITE));
+  g_object_class_install_property (gobject_class, PROP_LAZY_TEXT,
+      g_param_spec_boolean ("lazy-text", "Lazy text",
+          "Only index where the lines of the file are and read their text "
+          "while pushing, for files too large to hold", DEFAULT_LAZY_TEXT,
+          G_PARAM_READWRITE));
+  g_object_class_install_property (gobject_class, PROP_TITLE,
+      g_param_spec_string ("title", "Title",
+          "Title from the [ti:] header tag", NULL, G_PARAM_READABLE));
+  g_object_class_install_property (gobject_class, PROP_ARTIST,
+      g_param_spec_string ("artist", "Artist",
+          "Artist from the [ar:] header tag", NULL, G_PARAM_READABLE));
+  g_object_class_install_property (gobject_class, PROP_ALBUM,
+      g_param_spec_string ("album", "Album",
+          "Album from the [al:] header tag", NULL, G_PARAM_READABLE));
+  g_object_class_install_property (gobject_class, PROP_CREATOR,
+      g_param_spec_string ("creator", "Creator",
+          "Creator of the lyrics from the [by:] header tag", NULL,
+          G_PARAM_READABLE));
+  g_object_class_install_property (gobject_class, PROP_OFFSET,
+      g_param_spec_int ("offset", "Offset",
+          "Offset in milliseconds from the [offset:] header tag, already "
+          "applied to the cue timestamps", G_MININT, G_MAXINT, 0,
+          G_PARAM_READABLE));
+
   gstelement_class->change_state =
       GST_DEBUG_FUNCPTR (gst_lrc_demux_change_state);
 }
@@ -158,19 +248,64 @@ gst_lrc_demux_init (GstLrcDemux * lrc, GstLrcDemuxClass * gclass)
       GST_DEBUG_FUNCPTR (gst_lrc_demux_sink_activate_pull));
   gst_pad_set_chain_function (lrc->sinkpad,
       GST_DEBUG_FUNCPTR (gst_lrc_demux_chain));
+  gst_pad_set_event_function (lrc->sinkpad,
+      GST_DEBUG_FUNCPTR (gst_lrc_demux_sink_event));
   gst_element_add_pad (GST_ELEMENT (lrc), lrc->sinkpad);
 
   lrc->srcpad = gst_pad_new_from_static_template (&srctemplate, "src");
+  gst_pad_set_event_function (lrc->srcpad,
+      GST_DEBUG_FUNCPTR (gst_lrc_demux_src_event));
+  gst_pad_set_query_function (lrc->srcpad,
+      GST_DEBUG_FUNCPTR (gst_lrc_demux_src_query));
   gst_element_add_pad (GST_ELEMENT (lrc), lrc->srcpad);
 
-  lrc->lyricList = NULL;
+  gst_lrc_parser_init (&lrc->parser);
+  lrc->index = NULL;
+  lrc->cue = 0;
   lrc->lyrics = NULL;
   lrc->album = NULL;
   lrc->artist = NULL;
   lrc->creator = NULL;
   lrc->title = NULL;
   lrc->offset = 0;
+  lrc->use_cache = DEFAULT_USE_CACHE;
+  lrc->probe = DEFAULT_PROBE;
+  lrc->charset = NULL;
+  lrc->parse_threads = DEFAULT_PARSE_THREADS;
+  lrc->lazy_text = DEFAULT_LAZY_TEXT;
+  lrc->lazy_conv = NULL;
+  lrc->window = NULL;
+  lrc->window_offset = 0;
   lrc->parsed = FALSE;
+  lrc->tags_sent = FALSE;
+
+  gst_segment_init (&lrc->segment, GST_FORMAT_TIME);
+  lrc->segment_running = FALSE;
+  lrc->close_seg_event = NULL;
+  lrc->new_seg_event = NULL;
+
+  gst_lrc_converter_init (&lrc->converter, NULL);
+  gst_lrc_line_scanner_init (&lrc->scanner);
+  lrc->pending = g_queue_new ();
+  lrc->watermark = 0;
+  lrc->probed = FALSE;
+  lrc->n_cues = 0;
+  lrc->binary = NULL;
+  lrc->sniffed = FALSE;
+}
+
+static void
+gst_lrc_demux_clear_lazy (GstLrcDemux * lrc)
+{
+  if (lrc->lazy_conv) {
+    gst_lrc_converter_clear (lrc->lazy_conv);
+    g_slice_free (GstLrcConverter, lrc->lazy_conv);
+    lrc->lazy_conv = NULL;
+  }
+  if (lrc->window) {
+    gst_buffer_unref (lrc->window);
+    lrc->window = NULL;
+  }
 }
 
 static void
@@ -180,193 +315,1299 @@ gst_lrc_demux_finalize (GObject * object)
 
   GST_DEBUG ("lrc: finalize");
 
+  gst_lrc_parser_clear (&lrc->parser);
+  if (lrc->index)
+    gst_lrc_index_unref (lrc->index);
+
+  gst_lrc_converter_clear (&lrc->converter);
+  gst_lrc_line_scanner_clear (&lrc->scanner);
+  g_queue_foreach (lrc->pending, (GFunc) gst_buffer_unref, NULL);
+  g_queue_free (lrc->pending);
+  if (lrc->binary)
+    g_object_unref (lrc->binary);
+
+  g_free (lrc->charset);
+  gst_lrc_demux_clear_lazy (lrc);
+
+  g_free (lrc->title);
+  g_free (lrc->artist);
+  g_free (lrc->album);
+  g_free (lrc->creator);
+
   G_OBJECT_CLASS (parent_class)->finalize (object);
 }
 
-/* parse string, if valid, store data*/
-static gboolean
-gst_lrc_parse_line(GstLrcDemux *lrc, const gchar* line)
+static void
+gst_lrc_demux_set_property (GObject * object, guint prop_id,
+    const GValue * value, GParamSpec * pspec)
 {
-  guint min, sec, hsec;
-  gchar lyric[100];
-  GstBuffer *buf;
-  
-  GST_DEBUG("line str: %s", line);
-  if ( line[0] == '[' )
-  {
-    GstClockTime timestamp;
-    if (strncmp(line, "[ti:", 4) == 0) {
-    }
-    else if (strncmp(line, "[ar:", 4) == 0) {
-    }
-    else if (strncmp(line, "[al:", 4) == 0) {
-    }
-    else if (strncmp(line, "[by:", 4) == 0) {
-    }
-    else if (strncmp(line, "[re:", 4) == 0) {
-    }
-    else if (strncmp(line, "[ve:", 4) == 0) {
+  GstLrcDemux *lrc = GST_LRC_DEMUX (object);
 
-    }
-    else if (strncmp(line, "[offset:", 8) == 0) {
+  switch (prop_id) {
+    case PROP_USE_CACHE:
+      lrc->use_cache = g_value_get_boolean (value);
+      break;
+    case PROP_CACHE_SIZE:
+      gst_lrc_cache_set_budget (g_value_get_uint64 (value));
+      break;
+    case PROP_PROBE:
+      lrc->probe = g_value_get_boolean (value);
+      break;
+    case PROP_CHARSET:
+      GST_OBJECT_LOCK (lrc);
+      g_free (lrc->charset);
+      lrc->charset = g_value_dup_string (value);
+      GST_OBJECT_UNLOCK (lrc);
+      break;
+    case PROP_PARSE_THREADS:
+      lrc->parse_threads = g_value_get_uint (value);
+      break;
+    case PROP_LAZY_TEXT:
+      lrc->lazy_text = g_value_get_boolean (value);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+      break;
+  }
+}
 
-    }
-    else {
-      sscanf(line, "[%d:%d.%d]%s", &min, &sec, &hsec, lyric);
-      GST_DEBUG("zhaoliang %d:%d.%d", min, sec, hsec);
-      buf = gst_buffer_new_and_alloc(strlen(lyric)+1);
-      memset(GST_BUFFER_DATA(buf), 0, strlen(lyric)+1);
-      strcpy(GST_BUFFER_DATA(buf), lyric);
-      timestamp = (min * 60 + sec )* GST_SECOND + (hsec * 10 * GST_MSECOND);
-      GST_BUFFER_TIMESTAMP(buf) = timestamp;
-      GST_BUFFER_DURATION(buf) = GST_SECOND;
-      lrc->lyricList = g_list_append(lrc->lyricList, buf);
-      GST_DEBUG("append one");
+static void
+gst_lrc_demux_get_property (GObject * object, guint prop_id, GValue * value,
+    GParamSpec * pspec)
+{
+  GstLrcDemux *lrc = GST_LRC_DEMUX (object);
+  guint64 hits, misses;
+
+  switch (prop_id) {
+    case PROP_USE_CACHE:
+      g_value_set_boolean (value, lrc->use_cache);
+      break;
+    case PROP_CACHE_SIZE:
+      g_value_set_uint64 (value, gst_lrc_cache_get_budget ());
+      break;
+    case PROP_CACHE_HITS:
+      gst_lrc_cache_get_stats (&hits, NULL, NULL);
+      g_value_set_uint64 (value, hits);
+      break;
+    case PROP_CACHE_MISSES:
+      gst_lrc_cache_get_stats (NULL, &misses, NULL);
+      g_value_set_uint64 (value, misses);
+      break;
+    case PROP_PROBE:
+      g_value_set_boolean (value, lrc->probe);
+      break;
+    case PROP_CHARSET:
+      GST_OBJECT_LOCK (lrc);
+      g_value_set_string (value, lrc->charset);
+      GST_OBJECT_UNLOCK (lrc);
+      break;
+    case PROP_PARSE_THREADS:
+      g_value_set_uint (value, lrc->parse_threads);
+      break;
+    case PROP_LAZY_TEXT:
+      g_value_set_boolean (value, lrc->lazy_text);
+      break;
+    case PROP_TITLE:
+      GST_OBJECT_LOCK (lrc);
+      g_value_set_string (value, lrc->title);
+      GST_OBJECT_UNLOCK (lrc);
+      break;
+    case PROP_ARTIST:
+      GST_OBJECT_LOCK (lrc);
+      g_value_set_string (value, lrc->artist);
+      GST_OBJECT_UNLOCK (lrc);
+      break;
+    case PROP_ALBUM:
+      GST_OBJECT_LOCK (lrc);
+      g_value_set_string (value, lrc->album);
+      GST_OBJECT_UNLOCK (lrc);
+      break;
+    case PROP_CREATOR:
+      GST_OBJECT_LOCK (lrc);
+      g_value_set_string (value, lrc->creator);
+      GST_OBJECT_UNLOCK (lrc);
+      break;
+    case PROP_OFFSET:
+      GST_OBJECT_LOCK (lrc);
+      g_value_set_int (value, lrc->offset);
+      GST_OBJECT_UNLOCK (lrc);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+      break;
+  }
+}
+
+/* File name of the upstream resource if it is a local file read by the
+ * source right before us. The uri query would pass through elements in
+ * between, which may decrypt, decompress or otherwise change the data:
+ * the file is not what arrives on the sink pad then. */
+static gchar *
+gst_lrc_demux_get_upstream_file (GstLrcDemux * lrc, gchar ** urip)
+{
+  GstElement *src = NULL;
+  GstPad *peer;
+  GstQuery *query;
+  gchar *uri = NULL;
+  gchar *filename = NULL;
+
+  if ((peer = gst_pad_get_peer (lrc->sinkpad))) {
+    src = gst_pad_get_parent_element (peer);
+    gst_object_unref (peer);
+  }
+
+  if (src && GST_IS_URI_HANDLER (src) &&
+      gst_uri_handler_get_uri_type (GST_URI_HANDLER (src)) == GST_URI_SRC) {
+    query = gst_query_new_uri ();
+    if (gst_element_query (src, query))
+      gst_query_parse_uri (query, &uri);
+    gst_query_unref (query);
+  } else {
+    GST_DEBUG_OBJECT (lrc, "upstream is not a source, not mapping it");
+  }
+  if (src)
+    gst_object_unref (src);
+
+  if (uri && gst_uri_has_protocol (uri, "file"))
+    filename = g_filename_from_uri (uri, NULL, NULL);
+
+  if (urip)
+    *urip = uri;
+  else
+    g_free (uri);
+  return filename;
+}
+
+/* complete the cache key of a source, the same file parses into other
+ * text with another charset property */
+static gchar *
+gst_lrc_demux_make_key (GstLrcDemux * lrc, const gchar * source)
+{
+  gchar *key;
+
+  GST_OBJECT_LOCK (lrc);
+  key = g_strdup_printf ("%s:%s", source, lrc->charset ? lrc->charset : "");
+  GST_OBJECT_UNLOCK (lrc);
+
+  return key;
+}
+
+/* cache key for a local file, remote resources have no stable identity
+ * and are keyed by content once read */
+static gchar *
+gst_lrc_demux_get_source_key (GstLrcDemux * lrc)
+{
+  struct stat st;
+  gchar *filename;
+  gchar *uri = NULL;
+  gchar *source;
+  gchar *key = NULL;
+
+  filename = gst_lrc_demux_get_upstream_file (lrc, &uri);
+  if (filename && g_stat (filename, &st) == 0) {
+    source = g_strdup_printf ("%s:%" G_GINT64_FORMAT ":%ld", uri,
+        (gint64) st.st_size, (glong) st.st_mtime);
+    key = gst_lrc_demux_make_key (lrc, source);
+    g_free (source);
+  }
+
+  g_free (filename);
+  g_free (uri);
+  return key;
+}
+
+/* map the upstream resource directly when it is a local file */
+static GstBuffer *
+gst_lrc_demux_map_upstream (GstLrcDemux * lrc)
+{
+  GstBuffer *buf = NULL;
+  gchar *filename;
+
+  filename = gst_lrc_demux_get_upstream_file (lrc, NULL);
+
+  if (filename)
+    buf = gst_lrc_buffer_new_mapped (filename, NULL);
+
+  if (buf && GST_BUFFER_SIZE (buf) > 0) {
+    GST_DEBUG_OBJECT (lrc, "mapped %s, %u bytes", filename,
+        GST_BUFFER_SIZE (buf));
+  } else if (buf) {
+    gst_buffer_unref (buf);
+    buf = NULL;
+  }
+
+  g_free (filename);
+  return buf;
+}
+
+/* read the whole upstream resource into one contiguous buffer */
+static GstFlowReturn
+gst_lrc_demux_pull_all (GstLrcDemux * lrc, GstBuffer ** outbuf)
+{
+  GstFlowReturn res = GST_FLOW_OK;
+  GstFormat fmt = GST_FORMAT_BYTES;
+  GstAdapter *adapter;
+  GstBuffer *buf = NULL;
+  gint64 size = -1;
+  guint64 offset = 0;
+  guint avail;
+
+  *outbuf = gst_lrc_demux_map_upstream (lrc);
+  if (*outbuf)
+    return GST_FLOW_OK;
+
+  if (!gst_pad_query_peer_duration (lrc->sinkpad, &fmt, &size) ||
+      fmt != GST_FORMAT_BYTES)
+    size = -1;
+
+  /* known size: one pull covers the file, otherwise go on in big blocks */
+  if (size > 0 && size <= G_MAXUINT) {
+    res = gst_pad_pull_range (lrc->sinkpad, 0, (guint) size, &buf);
+    if (res != GST_FLOW_OK)
+      return res;
+    if (GST_BUFFER_SIZE (buf) == size) {
+      *outbuf = buf;
+      return GST_FLOW_OK;
     }
   }
+
+  adapter = gst_adapter_new ();
+  if (buf) {
+    offset = GST_BUFFER_SIZE (buf);
+    gst_adapter_push (adapter, buf);
+  }
+
+  while (res == GST_FLOW_OK) {
+    res = gst_pad_pull_range (lrc->sinkpad, offset, LRC_PULL_BLOCK_SIZE, &buf);
+    if (res != GST_FLOW_OK)
+      break;
+    offset += GST_BUFFER_SIZE (buf);
+    if (GST_BUFFER_SIZE (buf) < LRC_PULL_BLOCK_SIZE)
+      res = GST_FLOW_UNEXPECTED;
+    gst_adapter_push (adapter, buf);
+  }
+
+  avail = gst_adapter_available (adapter);
+  if (res == GST_FLOW_UNEXPECTED && avail > 0) {
+    *outbuf = gst_adapter_take_buffer (adapter, avail);
+    res = GST_FLOW_OK;
+  }
+  g_object_unref (adapter);
+
+  GST_DEBUG_OBJECT (lrc, "pulled %" G_GUINT64_FORMAT " bytes, res:%s", offset,
+      gst_flow_get_name (res));
+  return res;
+}
+
+/* start a converter for the charset property */
+static void
+gst_lrc_demux_init_converter (GstLrcDemux * lrc, GstLrcConverter * conv)
+{
+  GST_OBJECT_LOCK (lrc);
+  gst_lrc_converter_init (conv, lrc->charset);
+  GST_OBJECT_UNLOCK (lrc);
+}
+
+/* Report a pull that ended the parsing early. Flushing for a seek or a
+ * state change is no error, the file is parsed again on the next run. */
+static GstFlowReturn
+gst_lrc_demux_read_failed (GstLrcDemux * lrc, GstFlowReturn res)
+{
+  if (res == GST_FLOW_WRONG_STATE)
+    return res;
+
+  if (res == GST_FLOW_UNEXPECTED)
+    GST_ELEMENT_ERROR (lrc, STREAM, WRONG_TYPE, (NULL),
+        ("the lyrics file is empty"));
   else
-    GST_DEBUG("Invalid format, not support");
-  
-  return FALSE;
+    GST_ELEMENT_ERROR (lrc, RESOURCE, READ, (NULL),
+        ("could not read lyrics: %s", gst_flow_get_name (res)));
+  return GST_FLOW_ERROR;
+}
+
+/* a file without a single timestamped line is no lyrics */
+static GstFlowReturn
+gst_lrc_demux_check_cues (GstLrcDemux * lrc, guint n_cues)
+{
+  if (n_cues > 0)
+    return GST_FLOW_OK;
+
+  GST_ELEMENT_ERROR (lrc, STREAM, WRONG_TYPE, (NULL),
+      ("no timestamped lines in the lyrics"));
+  return GST_FLOW_ERROR;
 }
 
 /* parse data line by line */
-static gboolean
+static GstFlowReturn
 gst_lrc_parse_lyrics(GstLrcDemux *lrc)
 {
-  GstFlowReturn res = GST_FLOW_OK;
+  GstFlowReturn res;
   GstBuffer *buf = NULL;
-  guint obtained;
-  guint64 offset = 0;
-  gchar* line;
-  gchar* needle = NULL;
-  gchar* fragment = NULL;
+  GstLrcConverter conv;
+  const gchar* text;
+  gsize len;
+  gchar* key = NULL;
+  gchar* checksum;
+  gchar* source;
 
-  while(res == GST_FLOW_OK)  
+  if (lrc->use_cache)
   {
-    res = gst_pad_pull_range (lrc->sinkpad, offset, LRC_BLOCK_SIZE, &buf);
-    if ( res == GST_FLOW_OK )
+    key = gst_lrc_demux_get_source_key(lrc);
+    if (key && (lrc->index = gst_lrc_cache_lookup(key)))
+      goto done;
+  }
+
+  res = gst_lrc_demux_pull_all (lrc, &buf);
+  if (res != GST_FLOW_OK)
+  {
+    GST_DEBUG("could not read lyrics: %s", gst_flow_get_name (res));
+    g_free(key);
+    return gst_lrc_demux_read_failed(lrc, res);
+  }
+
+  /* precompiled by lrcindexenc, the mapped data is used as is */
+  if (gst_lrc_binary_detect(GST_BUFFER_DATA(buf), GST_BUFFER_SIZE(buf)))
+  {
+    lrc->index = gst_lrc_binary_read(buf, FALSE);
+    gst_buffer_unref(buf);
+    g_free(key);
+    if (!lrc->index)
     {
-      guint buflen = 0;
-      guint  linelen = 0;
-      gchar* data;
-
-      obtained = GST_BUFFER_SIZE (buf);
-      data = GST_BUFFER_DATA(buf);
-
-      buflen = obtained;
-      do
-      {
-        needle = g_strstr_len(data, buflen, "\n");
-        if (needle)
-        {
-          linelen = (needle - data);
-          if (fragment)
-          {
-            gchar* tmp;
-
-            tmp = g_strndup(data, linelen);
-            line = g_strjoin(NULL, fragment, tmp, NULL);
-            g_free(fragment);
-            g_free(tmp);
-            fragment = NULL;
-            tmp = NULL;
-          }
-          else
-          {
-            line = g_strndup(data, linelen);
-          }
-
-          data += linelen+1;
-          buflen -= linelen+1;
-          //parse line
-          gst_lrc_parse_line(lrc, line);
-          g_free(line);
-          line = NULL;
-        }
-      }while(needle != NULL);
+      GST_ELEMENT_ERROR(lrc, STREAM, DECODE, (NULL),
+          ("invalid lyrics index"));
+      return GST_FLOW_ERROR;
+    }
+    return gst_lrc_demux_check_cues(lrc, lrc->index->n_cues);
+  }
 
-      //handle fragment
-      if (buflen != 0)
-      {
-        fragment = g_strndup(data, buflen);
-      }
+  if (lrc->use_cache && !key)
+  {
+    checksum = g_compute_checksum_for_data(G_CHECKSUM_SHA1,
+        GST_BUFFER_DATA(buf), GST_BUFFER_SIZE(buf));
+    source = g_strconcat("sha1:", checksum, NULL);
+    key = gst_lrc_demux_make_key(lrc, source);
+    g_free(source);
+    g_free(checksum);
+    if ((lrc->index = gst_lrc_cache_lookup(key)))
+    {
       gst_buffer_unref(buf);
+      goto done;
     }
-    offset += obtained;
-    
-    //check if we got EOS
+  }
+
+  /* UTF-8 is parsed in place, other encodings are converted once */
+  gst_lrc_demux_init_converter(lrc, &conv);
+  text = gst_lrc_converter_convert_all(&conv,
+      (const gchar *) GST_BUFFER_DATA(buf), GST_BUFFER_SIZE(buf), &len);
+  /* the pushed cues are sub-buffers of the text block of the index */
+  if (lrc->parse_threads != 1)
+    lrc->index = gst_lrc_parser_parse_parallel(&lrc->parser, text, len,
+        lrc->parse_threads);
+  else
+  {
+    gst_lrc_parser_parse(&lrc->parser, text, len);
+    lrc->index = gst_lrc_parser_finish(&lrc->parser);
+  }
+  gst_lrc_converter_clear(&conv);
+  gst_buffer_unref(buf);
+
+  if (key)
+    gst_lrc_cache_insert(key, lrc->index);
+
+done:
+  GST_DEBUG("%u cues, key %s", lrc->index->n_cues, GST_STR_NULL(key));
+  g_free(key);
+  return gst_lrc_demux_check_cues(lrc, lrc->index->n_cues);
+}
+
+/* tags of a lazily indexed file are still in the charset of the source */
+static void
+gst_lrc_demux_convert_tags (GstLrcDemux * lrc)
+{
+  const gchar *text;
+  gchar *tag;
+  gsize len;
+  guint i;
+
+  for (i = 0; i < GST_LRC_TAG_COUNT; i++) {
+    if (!lrc->parser.tags[i])
+      continue;
+    gst_lrc_converter_reset (lrc->lazy_conv);
+    text = gst_lrc_converter_convert_all (lrc->lazy_conv,
+        lrc->parser.tags[i], strlen (lrc->parser.tags[i]), &len);
+    tag = g_strndup (text, len);
+    g_free (lrc->parser.tags[i]);
+    lrc->parser.tags[i] = tag;
+  }
+}
+
+/* Index a large file without holding its text: the cues locate their
+ * lines in the source and gst_lrc_demux_fetch_text reads them back while
+ * pushing. The file is read in blocks, the line scanner carries a line cut
+ * by the end of one into the next. The converter only tells the charset;
+ * binary indexes and UTF-16 are parsed as usual. */
+static GstFlowReturn
+gst_lrc_demux_index_lines (GstLrcDemux * lrc)
+{
+  GstFlowReturn res;
+  GstLrcConverter conv;
+  GstLrcLineScanner scanner;
+  GstBuffer *buf;
+  const gchar *data, *line;
+  guint64 offset = 0;
+  gsize size, len, skip = 0;
+
+  gst_lrc_demux_init_converter (lrc, &conv);
+  gst_lrc_line_scanner_init (&scanner);
+
+  for (;;) {
+    res = gst_pad_pull_range (lrc->sinkpad, offset, LRC_PULL_BLOCK_SIZE, &buf);
     if (res == GST_FLOW_UNEXPECTED)
-    {
-      if (fragment)
-      {
-        gst_lrc_parse_line(lrc, fragment);
-        g_free(fragment);
-        fragment = NULL;
+      break;
+    if (res != GST_FLOW_OK)
+      goto failed;
+
+    data = (const gchar *) GST_BUFFER_DATA (buf);
+    size = GST_BUFFER_SIZE (buf);
+
+    if (offset == 0) {
+      if (gst_lrc_binary_detect (GST_BUFFER_DATA (buf), size)) {
+        gst_buffer_unref (buf);
+        goto fallback;
       }
-      GST_DEBUG("receive eos");
+      if (size >= 3 && memcmp (data, "\xef\xbb\xbf", 3) == 0)
+        skip = 3;
+    }
+
+    /* a byte order mark wins over the charset property */
+    if (!conv.detected || !conv.started)
+      gst_lrc_converter_convert (&conv, data, size, &len);
+    if (conv.wide) {
+      gst_buffer_unref (buf);
+      goto fallback;
+    }
+
+    /* the scanner counts from behind the byte order mark */
+    if (offset == 0)
+      gst_lrc_line_scanner_feed (&scanner, data + skip, size - skip);
+    else
+      gst_lrc_line_scanner_feed (&scanner, data, size);
+    while (gst_lrc_line_scanner_next (&scanner, &line, &len))
+      gst_lrc_parse_line_ref (&lrc->parser, line, len, skip + scanner.offset);
+
+    offset += size;
+    gst_buffer_unref (buf);
+
+    if (size < LRC_PULL_BLOCK_SIZE)
+      break;
+  }
+
+  if (gst_lrc_line_scanner_finish (&scanner, &line, &len))
+    gst_lrc_parse_line_ref (&lrc->parser, line, len, skip + scanner.offset);
+  gst_lrc_line_scanner_clear (&scanner);
+
+  if (!conv.detected)
+    gst_lrc_converter_finish (&conv, &len);
+  if (conv.wide)
+    goto fallback;
+
+  /* one converter for all the lines of the stream, the byte order mark
+   * is already behind the first one */
+  lrc->lazy_conv = g_slice_new (GstLrcConverter);
+  gst_lrc_converter_init (lrc->lazy_conv,
+      conv.detected ? conv.charset : "UTF-8");
+  gst_lrc_converter_skip_start (lrc->lazy_conv);
+  gst_lrc_converter_clear (&conv);
+
+  gst_lrc_demux_convert_tags (lrc);
+  lrc->index = gst_lrc_parser_finish (&lrc->parser);
+
+  GST_DEBUG_OBJECT (lrc, "indexed %u cues in %" G_GUINT64_FORMAT " bytes of "
+      "%s", lrc->index->n_cues, offset, lrc->lazy_conv->charset);
+  return gst_lrc_demux_check_cues (lrc, lrc->index->n_cues);
+
+fallback:
+  GST_DEBUG_OBJECT (lrc, "can not index lazily, parsing all of it");
+  gst_lrc_line_scanner_clear (&scanner);
+  gst_lrc_converter_clear (&conv);
+  gst_lrc_parser_rewind (&lrc->parser);
+  return gst_lrc_parse_lyrics (lrc);
+
+failed:
+  GST_DEBUG_OBJECT (lrc, "could not index lyrics: %s",
+      gst_flow_get_name (res));
+  gst_lrc_line_scanner_clear (&scanner);
+  gst_lrc_converter_clear (&conv);
+  gst_lrc_parser_rewind (&lrc->parser);
+  return res == GST_FLOW_ERROR ? res : gst_lrc_demux_read_failed (lrc, res);
+}
+
+/* Read the header in small blocks and stop at the first timestamped line,
+ * the tags are all that is wanted in probe mode. A binary index keeps its
+ * tags behind the cue table, it is loaded as a whole. A header without
+ * any timestamped line after it is fine here. */
+static GstFlowReturn
+gst_lrc_demux_probe_header (GstLrcDemux * lrc)
+{
+  GstFlowReturn res = GST_FLOW_OK;
+  GstLrcConverter conv;
+  GstLrcLineScanner scanner;
+  GstBuffer *buf;
+  guint64 offset = 0;
+  const gchar *text;
+  const gchar *line;
+  gsize len, linelen;
+  gboolean found = FALSE;
+  gboolean last;
+
+  gst_lrc_demux_init_converter (lrc, &conv);
+  gst_lrc_line_scanner_init (&scanner);
+
+  while (!found && res == GST_FLOW_OK) {
+    res = gst_pad_pull_range (lrc->sinkpad, offset, LRC_PROBE_BLOCK_SIZE,
+        &buf);
+    if (res != GST_FLOW_OK)
       break;
+
+    if (offset == 0 && gst_lrc_binary_detect (GST_BUFFER_DATA (buf),
+            GST_BUFFER_SIZE (buf))) {
+      gst_buffer_unref (buf);
+      gst_lrc_line_scanner_clear (&scanner);
+      gst_lrc_converter_clear (&conv);
+      return gst_lrc_parse_lyrics (lrc);
+    }
+
+    offset += GST_BUFFER_SIZE (buf);
+    last = GST_BUFFER_SIZE (buf) < LRC_PROBE_BLOCK_SIZE;
+
+    text = gst_lrc_converter_convert (&conv,
+        (const gchar *) GST_BUFFER_DATA (buf), GST_BUFFER_SIZE (buf), &len);
+    gst_lrc_line_scanner_feed (&scanner, text, len);
+    while (!found && gst_lrc_line_scanner_next (&scanner, &line, &linelen))
+      found = gst_lrc_parse_line (&lrc->parser, line, linelen);
+    if (!found && last) {
+      text = gst_lrc_converter_finish (&conv, &len);
+      gst_lrc_line_scanner_feed (&scanner, text, len);
+      while (!found && gst_lrc_line_scanner_next (&scanner, &line, &linelen))
+        found = gst_lrc_parse_line (&lrc->parser, line, linelen);
     }
+    if (!found && last &&
+        gst_lrc_line_scanner_finish (&scanner, &line, &linelen))
+      found = gst_lrc_parse_line (&lrc->parser, line, linelen);
+    gst_buffer_unref (buf);
+
+    if (last)
+      break;
   }
-  
-  if (!lrc->lyricList)
-    return FALSE;
+
+  gst_lrc_line_scanner_clear (&scanner);
+  gst_lrc_converter_clear (&conv);
+  gst_lrc_parser_reset (&lrc->parser);
+
+  GST_DEBUG_OBJECT (lrc, "probed %" G_GUINT64_FORMAT " bytes, res:%s",
+      offset, gst_flow_get_name (res));
+  if (res != GST_FLOW_OK && res != GST_FLOW_UNEXPECTED)
+    return gst_lrc_demux_read_failed (lrc, res);
+  return GST_FLOW_OK;
 }
 
+/* Keep the header tags for the properties and announce them as one tag
+ * list, posted on the bus and sent downstream. Done once per stream,
+ * after the newsegment. */
 static void
-gst_lrc_demux_loop (GstPad * pad)
+gst_lrc_demux_send_tags (GstLrcDemux * lrc)
+{
+  GstTagList *list;
+  gchar **tags;
+  gint offset;
+
+  if (lrc->tags_sent)
+    return;
+  lrc->tags_sent = TRUE;
+
+  if (lrc->index) {
+    tags = lrc->index->tags;
+    offset = lrc->index->offset;
+  } else {
+    tags = lrc->parser.tags;
+    offset = lrc->parser.offset;
+  }
+
+  GST_OBJECT_LOCK (lrc);
+  g_free (lrc->title);
+  lrc->title = g_strdup (tags[GST_LRC_TAG_TITLE]);
+  g_free (lrc->artist);
+  lrc->artist = g_strdup (tags[GST_LRC_TAG_ARTIST]);
+  g_free (lrc->album);
+  lrc->album = g_strdup (tags[GST_LRC_TAG_ALBUM]);
+  g_free (lrc->creator);
+  lrc->creator = g_strdup (tags[GST_LRC_TAG_CREATOR]);
+  lrc->offset = offset;
+  GST_OBJECT_UNLOCK (lrc);
+
+  list = gst_lrc_tags_to_tag_list (tags);
+  if (list) {
+    GST_DEBUG_OBJECT (lrc, "found tags %" GST_PTR_FORMAT, list);
+    gst_element_found_tags_for_pad (GST_ELEMENT (lrc), lrc->srcpad, list);
+  }
+}
+
+/* create the buffer for a cue. Once the whole file is parsed this is a
+ * sub-buffer of the shared text block, in push mode the text is copied
+ * out of the per-line scratch block. */
+static void
+gst_lrc_demux_stamp_buffer (GstBuffer * buf, const GstLrcCue * cue)
+{
+  GST_BUFFER_TIMESTAMP (buf) = cue->start;
+  GST_BUFFER_DURATION (buf) = GST_CLOCK_TIME_NONE;
+}
+
+static GstBuffer *
+gst_lrc_demux_create_buffer (GstLrcDemux * lrc, const GstLrcCue * cue)
+{
+  GstBuffer *buf;
+
+  if (lrc->index) {
+    /* binary indexes are not verified up front, check before touching */
+    if ((guint64) cue->offset + cue->length + 1 >
+        GST_BUFFER_SIZE (lrc->index->text))
+      return NULL;
+    buf = gst_buffer_create_sub (lrc->index->text, cue->offset,
+        cue->length + 1);
+  } else {
+    buf = gst_buffer_new_and_alloc (cue->length + 1);
+    memcpy (GST_BUFFER_DATA (buf), lrc->parser.text->data + cue->offset,
+        cue->length + 1);
+  }
+  gst_lrc_demux_stamp_buffer (buf, cue);
+
+  return buf;
+}
+
+/* Read the line of a lazily indexed cue back and create its buffer. The
+ * line comes out of a window of the source, which holds the lines of the
+ * next cues as well when the file is in time order. */
+static GstFlowReturn
+gst_lrc_demux_fetch_text (GstLrcDemux * lrc, const GstLrcCue * cue,
+    GstBuffer ** outbuf)
 {
-  gboolean ret;
   GstFlowReturn res;
   GstBuffer *buf;
+  const gchar *line, *text;
+  gsize len, textlen;
+
+  if (!lrc->window || cue->offset < lrc->window_offset ||
+      (guint64) cue->offset + cue->length >
+      lrc->window_offset + GST_BUFFER_SIZE (lrc->window)) {
+    if (lrc->window) {
+      gst_buffer_unref (lrc->window);
+      lrc->window = NULL;
+    }
+    res = gst_pad_pull_range (lrc->sinkpad, cue->offset,
+        MAX (cue->length, LRC_LAZY_WINDOW), &lrc->window);
+    if (res != GST_FLOW_OK) {
+      lrc->window = NULL;
+      return res;
+    }
+    lrc->window_offset = cue->offset;
+
+    if (GST_BUFFER_SIZE (lrc->window) < cue->length) {
+      GST_ELEMENT_ERROR (lrc, STREAM, DEMUX, (NULL),
+          ("line at %u is beyond the end of the file", cue->offset));
+      return GST_FLOW_ERROR;
+    }
+  }
+
+  line = (const gchar *) GST_BUFFER_DATA (lrc->window) +
+      (cue->offset - lrc->window_offset);
+  gst_lrc_converter_reset (lrc->lazy_conv);
+  line = gst_lrc_converter_convert_all (lrc->lazy_conv, line, cue->length,
+      &len);
+  text = gst_lrc_parser_line_text (&lrc->parser, line, len, &textlen);
+
+  buf = gst_buffer_new_and_alloc (textlen + 1);
+  memcpy (GST_BUFFER_DATA (buf), text, textlen);
+  GST_BUFFER_DATA (buf)[textlen] = '\0';
+  gst_lrc_demux_stamp_buffer (buf, cue);
+
+  *outbuf = buf;
+  return GST_FLOW_OK;
+}
+
+/* Nothing is shown until time. Lyrics are a sparse stream, move the
+ * segment start of downstream forward so that sinks and mixers do not wait
+ * for text during the silence. */
+static void
+gst_lrc_demux_send_gap (GstLrcDemux * lrc, GstClockTime time)
+{
+  gint64 position;
+
+  if (lrc->segment.stop != -1 && time > lrc->segment.stop)
+    time = lrc->segment.stop;
+  if (time <= lrc->segment.start)
+    return;
+
+  position = lrc->segment.time + (time - lrc->segment.start);
+  GST_DEBUG_OBJECT (lrc, "silence until %" GST_TIME_FORMAT,
+      GST_TIME_ARGS (time));
+  gst_pad_push_event (lrc->srcpad, gst_event_new_new_segment (TRUE,
+          lrc->segment.rate, GST_FORMAT_TIME, time, lrc->segment.stop,
+          position));
+  gst_segment_set_last_stop (&lrc->segment, GST_FORMAT_TIME, time);
+}
+
+static void
+gst_lrc_demux_loop (GstPad * pad)
+{
+  GstFlowReturn res = GST_FLOW_OK;
+  GstBuffer *buf;
+  GstLrcCue *cue;
+  gint64 start, stop;
   
   GstLrcDemux *lrc = GST_LRC_DEMUX (GST_PAD_PARENT (pad));
 
   if (!lrc->parsed)
   {
-    ret = gst_lrc_parse_lyrics(lrc);
-    if (!ret)
-    {
-      //report error
-    }
+    if (lrc->probe)
+      res = gst_lrc_demux_probe_header(lrc);
+    else if (lrc->lazy_text)
+      res = gst_lrc_demux_index_lines(lrc);
+    else
+      res = gst_lrc_parse_lyrics(lrc);
+    /* the error is posted already, pausing adds the reason */
+    if (res != GST_FLOW_OK)
+      goto pause;
     lrc->parsed = TRUE;
-  lrc->lyricList = g_list_first(lrc->lyricList);
+    if (lrc->index)
+      lrc->cue = gst_lrc_cues_find (lrc->index->cues, lrc->index->n_cues,
+          lrc->segment.start);
   }
 
-  //start push buf from list
-  if (lrc->lyricList)
-  {
-    buf = (GstBuffer *) lrc->lyricList->data;
-    if (buf)
-    {
-      GST_DEBUG("push data buf=%x", buf);
-      res = gst_pad_push (lrc->srcpad, buf);
+  if (lrc->close_seg_event) {
+    gst_pad_push_event (lrc->srcpad, lrc->close_seg_event);
+    lrc->close_seg_event = NULL;
+  }
+  if (!lrc->segment_running || lrc->new_seg_event) {
+    if (!lrc->new_seg_event)
+      lrc->new_seg_event = gst_event_new_new_segment (FALSE,
+          lrc->segment.rate, GST_FORMAT_TIME, lrc->segment.start,
+          lrc->segment.stop, lrc->segment.time);
+    gst_pad_push_event (lrc->srcpad, lrc->new_seg_event);
+    lrc->new_seg_event = NULL;
+    lrc->segment_running = TRUE;
+  }
+  gst_lrc_demux_send_tags (lrc);
+
+  if (lrc->probe || !lrc->index || lrc->cue >= lrc->index->n_cues)
+    goto eos;
+
+  //start push buf from the cue index
+  cue = &lrc->index->cues[lrc->cue];
+  lrc->cue++;
+
+  if (lrc->segment.stop != -1 && cue->start >= lrc->segment.stop)
+    goto eos;
+
+  /* an empty line ends the previous lyric and starts a silence */
+  if (cue->length == 0) {
+    if (GST_CLOCK_TIME_IS_VALID (cue->stop))
+      gst_lrc_demux_send_gap (lrc, cue->stop);
+    return;
+  }
+
+  /* a cue already showing at the segment start is clipped to it */
+  if (!gst_segment_clip (&lrc->segment, GST_FORMAT_TIME, cue->start,
+          GST_CLOCK_TIME_IS_VALID (cue->stop) ? (gint64) cue->stop : -1,
+          &start, &stop))
+    return;
+
+  if (lrc->lazy_conv) {
+    res = gst_lrc_demux_fetch_text (lrc, cue, &buf);
+    if (res != GST_FLOW_OK)
+      goto pause;
+  } else {
+    buf = gst_lrc_demux_create_buffer (lrc, cue);
+    if (!buf) {
+      GST_ELEMENT_ERROR (lrc, STREAM, DEMUX, (NULL),
+          ("cue %u points outside of the text block", lrc->cue - 1));
+      res = GST_FLOW_ERROR;
+      goto pause;
     }
-    lrc->lyricList = g_list_next(lrc->lyricList);
+  }
+  GST_BUFFER_TIMESTAMP (buf) = start;
+  if (stop != -1)
+    GST_BUFFER_DURATION (buf) = stop - start;
+
+  /* word times count from the timestamp. The text block is shared, a
+   * clipped enhanced cue gets its own copy to move them in. */
+  if (start != cue->start && gst_lrc_words_count (GST_BUFFER_DATA (buf),
+          GST_BUFFER_SIZE (buf)) > 0) {
+    GstBuffer *copy = gst_buffer_copy (buf);
+
+    gst_buffer_unref (buf);
+    buf = copy;
+    gst_lrc_words_shift (GST_BUFFER_DATA (buf), GST_BUFFER_SIZE (buf),
+        start - cue->start);
+  }
+
+  gst_segment_set_last_stop (&lrc->segment, GST_FORMAT_TIME, start);
 
-    if (!lrc->lyricList)
+  GST_DEBUG("push data buf=%p", buf);
+  res = gst_pad_push (lrc->srcpad, buf);
+  if (res != GST_FLOW_OK)
+    goto pause;
+
+  return;
+
+eos:
+  res = GST_FLOW_UNEXPECTED;
+pause:
+  GST_LOG_OBJECT (lrc, "pausing task, res:%s", gst_flow_get_name (res));
+  lrc->segment_running = FALSE;
+  gst_pad_pause_task (pad);
+
+  if (res == GST_FLOW_UNEXPECTED) {
+    if (lrc->segment.flags & GST_SEEK_FLAG_SEGMENT) {
+      gst_element_post_message (GST_ELEMENT (lrc),
+          gst_message_new_segment_done (GST_OBJECT (lrc), GST_FORMAT_TIME,
+              lrc->segment.stop != -1 ? lrc->segment.stop :
+              lrc->segment.last_stop));
+    } else {
       gst_pad_push_event (lrc->srcpad, gst_event_new_eos ());
+    }
+  } else if (GST_FLOW_IS_FATAL (res) || res == GST_FLOW_NOT_LINKED) {
+    GST_ELEMENT_ERROR (lrc, STREAM, FAILED, (NULL),
+        ("streaming stopped, reason %s", gst_flow_get_name (res)));
+    gst_pad_push_event (lrc->srcpad, gst_event_new_eos ());
   }
+}
+
+static gboolean
+gst_lrc_demux_handle_seek (GstLrcDemux * lrc, GstEvent * event)
+{
+  gdouble rate;
+  GstFormat format;
+  GstSeekFlags flags;
+  GstSeekType start_type, stop_type;
+  gint64 start, stop;
+  gboolean flush, update;
+  GstSegment seeksegment;
+
+  gst_event_parse_seek (event, &rate, &format, &flags, &start_type, &start,
+      &stop_type, &stop);
+
+  if (format != GST_FORMAT_TIME || rate <= 0.0) {
+    GST_DEBUG_OBJECT (lrc, "only forward seeks in time are supported");
+    return FALSE;
+  }
+
+  flush = !!(flags & GST_SEEK_FLAG_FLUSH);
+
+  /* get the streaming thread out of the way */
+  if (flush)
+    gst_pad_push_event (lrc->srcpad, gst_event_new_flush_start ());
   else
-    gst_pad_pause_task (pad); 
+    gst_pad_pause_task (lrc->sinkpad);
 
-  GST_LOG_OBJECT (lrc, "res:%s", gst_flow_get_name (res));
-  return;
+  GST_PAD_STREAM_LOCK (lrc->sinkpad);
+
+  memcpy (&seeksegment, &lrc->segment, sizeof (GstSegment));
+  gst_segment_set_seek (&seeksegment, rate, format, flags, start_type, start,
+      stop_type, stop, &update);
+
+  if (flush) {
+    gst_pad_push_event (lrc->srcpad, gst_event_new_flush_stop ());
+  } else if (lrc->segment_running) {
+    /* close the segment that was playing so far */
+    if (lrc->close_seg_event)
+      gst_event_unref (lrc->close_seg_event);
+    lrc->close_seg_event = gst_event_new_new_segment (TRUE,
+        lrc->segment.rate, GST_FORMAT_TIME, lrc->segment.start,
+        lrc->segment.last_stop, lrc->segment.time);
+  }
+
+  memcpy (&lrc->segment, &seeksegment, sizeof (GstSegment));
+
+  if (lrc->segment.flags & GST_SEEK_FLAG_SEGMENT) {
+    gst_element_post_message (GST_ELEMENT (lrc),
+        gst_message_new_segment_start (GST_OBJECT (lrc), GST_FORMAT_TIME,
+            lrc->segment.start));
+  }
+
+  /* the index is sorted, the first cue to show is a binary search away */
+  if (lrc->index)
+    lrc->cue = gst_lrc_cues_find (lrc->index->cues, lrc->index->n_cues,
+        lrc->segment.start);
+
+  GST_DEBUG_OBJECT (lrc, "seek to %" GST_TIME_FORMAT ", cue %u",
+      GST_TIME_ARGS (lrc->segment.start), lrc->cue);
+
+  if (lrc->new_seg_event)
+    gst_event_unref (lrc->new_seg_event);
+  lrc->new_seg_event = gst_event_new_new_segment (FALSE, lrc->segment.rate,
+      GST_FORMAT_TIME, lrc->segment.start, lrc->segment.stop,
+      lrc->segment.time);
+
+  gst_pad_start_task (lrc->sinkpad, (GstTaskFunction) gst_lrc_demux_loop,
+      lrc->sinkpad);
+
+  GST_PAD_STREAM_UNLOCK (lrc->sinkpad);
+
+  return TRUE;
+}
+
+static gboolean
+gst_lrc_demux_src_event (GstPad * pad, GstEvent * event)
+{
+  GstLrcDemux *lrc = GST_LRC_DEMUX (gst_pad_get_parent (pad));
+  gboolean res;
+
+  GST_DEBUG_OBJECT (lrc, "handling %s event", GST_EVENT_TYPE_NAME (event));
+
+  switch (GST_EVENT_TYPE (event)) {
+    case GST_EVENT_SEEK:
+      /* only the pull task can jump around in the index */
+      if (lrc->parsed || gst_pad_check_pull_range (lrc->sinkpad))
+        res = gst_lrc_demux_handle_seek (lrc, event);
+      else
+        res = FALSE;
+      gst_event_unref (event);
+      break;
+    default:
+      res = gst_pad_event_default (pad, event);
+      break;
+  }
+
+  gst_object_unref (lrc);
+  return res;
+}
+
+static gboolean
+gst_lrc_demux_src_query (GstPad * pad, GstQuery * query)
+{
+  GstLrcDemux *lrc = GST_LRC_DEMUX (gst_pad_get_parent (pad));
+  GstFormat format;
+  gboolean res = FALSE;
+
+  switch (GST_QUERY_TYPE (query)) {
+    case GST_QUERY_DURATION:
+      gst_query_parse_duration (query, &format, NULL);
+      if (format != GST_FORMAT_TIME || !lrc->parsed || !lrc->index)
+        break;
+      if (GST_CLOCK_TIME_IS_VALID (gst_lrc_index_get_duration (lrc->index))) {
+        gst_query_set_duration (query, GST_FORMAT_TIME,
+            gst_lrc_index_get_duration (lrc->index));
+        res = TRUE;
+      }
+      break;
+    case GST_QUERY_POSITION:
+      gst_query_parse_position (query, &format, NULL);
+      if (format != GST_FORMAT_TIME || lrc->segment.last_stop == -1)
+        break;
+      gst_query_set_position (query, GST_FORMAT_TIME,
+          lrc->segment.last_stop);
+      res = TRUE;
+      break;
+    case GST_QUERY_SEEKING:
+      gst_query_parse_seeking (query, &format, NULL, NULL, NULL);
+      if (format != GST_FORMAT_TIME)
+        break;
+      gst_query_set_seeking (query, GST_FORMAT_TIME,
+          lrc->parsed || gst_pad_check_pull_range (lrc->sinkpad), 0,
+          lrc->parsed && lrc->index ?
+          (gint64) gst_lrc_index_get_duration (lrc->index) : -1);
+      res = TRUE;
+      break;
+    default:
+      res = gst_pad_query_default (pad, query);
+      break;
+  }
+
+  gst_object_unref (lrc);
+  return res;
+}
+
+static gint
+gst_lrc_demux_compare_pending (gconstpointer a, gconstpointer b, gpointer data)
+{
+  const GstBuffer *ba = a;
+  const GstBuffer *bb = b;
+
+  /* equal timestamps keep file order */
+  return GST_BUFFER_TIMESTAMP (ba) <= GST_BUFFER_TIMESTAMP (bb) ? -1 : 1;
+}
+
+/* parse one line in push mode and move its cues to the pending queue, the
+ * [offset:] of the header applies to the lines after it */
+static void
+gst_lrc_demux_queue_line (GstLrcDemux * lrc, const gchar * line, gsize len)
+{
+  GstLrcCue *cue;
+  GstClockTime watermark = GST_CLOCK_TIME_NONE;
+  guint i;
+
+  gst_lrc_parse_line (&lrc->parser, line, len);
+
+  lrc->n_cues += lrc->parser.cues->len;
+  for (i = 0; i < lrc->parser.cues->len; i++) {
+    cue = &g_array_index (lrc->parser.cues, GstLrcCue, i);
+    cue->start = gst_lrc_cue_shift (cue->start, lrc->parser.offset);
+    g_queue_insert_sorted (lrc->pending, gst_lrc_demux_create_buffer (lrc, cue),
+        gst_lrc_demux_compare_pending, NULL);
+    watermark = MIN (watermark, cue->start);
+  }
+
+  if (lrc->parser.cues->len > 0) {
+    if (watermark < lrc->watermark)
+      GST_DEBUG_OBJECT (lrc, "timestamp %" GST_TIME_FORMAT " out of order",
+          GST_TIME_ARGS (watermark));
+    lrc->watermark = watermark;
+  }
+
+  gst_lrc_parser_reset (&lrc->parser);
+}
+
+/* the time segment and the tags go out before the first cue */
+static void
+gst_lrc_demux_start_stream (GstLrcDemux * lrc)
+{
+  if (!lrc->segment_running) {
+    gst_pad_push_event (lrc->srcpad, gst_event_new_new_segment (FALSE, 1.0,
+            GST_FORMAT_TIME, 0, -1, 0));
+    lrc->segment_running = TRUE;
+  }
+  gst_lrc_demux_send_tags (lrc);
+}
+
+/* Push the pending cues whose stop is known. Lines in a file come in time
+ * order, so once a line at the watermark was seen, no later line can start
+ * a cue before it. A watermark of GST_CLOCK_TIME_NONE drains the queue. */
+static GstFlowReturn
+gst_lrc_demux_push_pending (GstLrcDemux * lrc, GstClockTime watermark)
+{
+  GstFlowReturn res = GST_FLOW_OK;
+  GstBuffer *head;
+  GstBuffer *next;
+  guint i;
+
+  while ((head = g_queue_peek_head (lrc->pending))) {
+    for (i = 1; (next = g_queue_peek_nth (lrc->pending, i)); i++) {
+      if (GST_BUFFER_TIMESTAMP (next) > GST_BUFFER_TIMESTAMP (head))
+        break;
+    }
+
+    /* the last cue lasts until the end of the stream */
+    if (next && GST_BUFFER_TIMESTAMP (next) <= watermark)
+      GST_BUFFER_DURATION (head) =
+          GST_BUFFER_TIMESTAMP (next) - GST_BUFFER_TIMESTAMP (head);
+    else if (watermark != GST_CLOCK_TIME_NONE)
+      break;
+
+    g_queue_pop_head (lrc->pending);
+
+    if (res != GST_FLOW_OK) {
+      gst_buffer_unref (head);
+      continue;
+    }
+
+    gst_lrc_demux_start_stream (lrc);
+
+    /* only the terminating NUL, a silence */
+    if (GST_BUFFER_SIZE (head) == 1) {
+      if (next)
+        gst_lrc_demux_send_gap (lrc, GST_BUFFER_TIMESTAMP (next));
+      gst_buffer_unref (head);
+      continue;
+    }
+
+    gst_segment_set_last_stop (&lrc->segment, GST_FORMAT_TIME,
+        GST_BUFFER_TIMESTAMP (head));
+
+    GST_DEBUG_OBJECT (lrc, "push cue at %" GST_TIME_FORMAT,
+        GST_TIME_ARGS (GST_BUFFER_TIMESTAMP (head)));
+    res = gst_pad_push (lrc->srcpad, head);
+  }
+
+  return res;
+}
+
+static void
+gst_lrc_demux_reset_stream (GstLrcDemux * lrc)
+{
+  gst_lrc_converter_clear (&lrc->converter);
+  gst_lrc_demux_init_converter (lrc, &lrc->converter);
+  gst_lrc_line_scanner_clear (&lrc->scanner);
+  gst_lrc_line_scanner_init (&lrc->scanner);
+  g_queue_foreach (lrc->pending, (GFunc) gst_buffer_unref, NULL);
+  g_queue_clear (lrc->pending);
+  lrc->watermark = 0;
+  lrc->segment_running = FALSE;
+  lrc->tags_sent = FALSE;
+  lrc->probed = FALSE;
+  lrc->sniffed = FALSE;
+  lrc->n_cues = 0;
+
+  /* the index read from a binary stream goes with it */
+  if (lrc->binary) {
+    g_object_unref (lrc->binary);
+    lrc->binary = NULL;
+    if (lrc->index) {
+      gst_lrc_index_unref (lrc->index);
+      lrc->index = NULL;
+    }
+  }
+
+  /* tags of the previous stream must not leak into the next one */
+  gst_lrc_parser_rewind (&lrc->parser);
+}
+
+/* Read the binary index collected from upstream and queue all its cues,
+ * or just take its tags in probe mode. */
+static gboolean
+gst_lrc_demux_read_binary (GstLrcDemux * lrc)
+{
+  GstBuffer *buf;
+  guint avail, i;
+
+  avail = gst_adapter_available (lrc->binary);
+  buf = gst_adapter_take_buffer (lrc->binary, avail);
+  lrc->index = gst_lrc_binary_read (buf, TRUE);
+  gst_buffer_unref (buf);
+  if (!lrc->index) {
+    GST_ELEMENT_ERROR (lrc, STREAM, DECODE, (NULL),
+        ("invalid lyrics index of %u bytes", avail));
+    return FALSE;
+  }
+
+  GST_DEBUG_OBJECT (lrc, "read %u cues from a binary index",
+      lrc->index->n_cues);
+  lrc->n_cues = lrc->index->n_cues;
+  if (lrc->probe)
+    return TRUE;
+
+  /* the index is sorted already */
+  for (i = 0; i < lrc->index->n_cues; i++) {
+    buf = gst_lrc_demux_create_buffer (lrc, &lrc->index->cues[i]);
+    if (!buf) {
+      GST_ELEMENT_ERROR (lrc, STREAM, DEMUX, (NULL),
+          ("cue %u points outside of the text block", i));
+      return FALSE;
+    }
+    g_queue_push_tail (lrc->pending, buf);
+  }
+  return TRUE;
 }
 
 static GstFlowReturn
 gst_lrc_demux_chain (GstPad * pad, GstBuffer * buf)
 {
-  GstFlowReturn res;
+  GstFlowReturn res = GST_FLOW_OK;
   GstLrcDemux *lrc = GST_LRC_DEMUX (GST_PAD_PARENT (pad));
+  const gchar *text;
+  const gchar *line;
+  gsize len, linelen;
 
   GST_DEBUG ("Store %d bytes ", GST_BUFFER_SIZE (buf));
 
-  res = gst_pad_push (lrc->srcpad, buf);
+  if (lrc->probed) {
+    gst_buffer_unref (buf);
+    return GST_FLOW_UNEXPECTED;
+  }
+
+  /* a binary index can only be read as a whole */
+  if (!lrc->sniffed) {
+    lrc->sniffed = TRUE;
+    if (GST_BUFFER_SIZE (buf) >= 4 &&
+        memcmp (GST_BUFFER_DATA (buf), LRC_BINARY_MAGIC, 4) == 0) {
+      GST_DEBUG_OBJECT (lrc, "collecting a binary index");
+      lrc->binary = gst_adapter_new ();
+    }
+  }
+  if (lrc->binary) {
+    gst_adapter_push (lrc->binary, buf);
+    return GST_FLOW_OK;
+  }
+
+  /* the scanner only keeps the partial last line of the buffer */
+  text = gst_lrc_converter_convert (&lrc->converter,
+      (const gchar *) GST_BUFFER_DATA (buf), GST_BUFFER_SIZE (buf), &len);
+  gst_lrc_line_scanner_feed (&lrc->scanner, text, len);
+  while (res == GST_FLOW_OK &&
+      gst_lrc_line_scanner_next (&lrc->scanner, &line, &linelen)) {
+    /* the header ends at the first timestamped line */
+    if (lrc->probe) {
+      if (gst_lrc_parse_line (&lrc->parser, line, linelen)) {
+        gst_lrc_parser_reset (&lrc->parser);
+        lrc->probed = TRUE;
+        res = GST_FLOW_UNEXPECTED;
+      }
+      continue;
+    }
+    gst_lrc_demux_queue_line (lrc, line, linelen);
+    res = gst_lrc_demux_push_pending (lrc, lrc->watermark);
+  }
+
   gst_buffer_unref (buf);
   return res;
 }
 
+static gboolean
+gst_lrc_demux_sink_event (GstPad * pad, GstEvent * event)
+{
+  GstLrcDemux *lrc = GST_LRC_DEMUX (gst_pad_get_parent (pad));
+  const gchar *text;
+  const gchar *line;
+  gsize len, linelen;
+  gboolean res;
+
+  GST_DEBUG_OBJECT (lrc, "handling %s event", GST_EVENT_TYPE_NAME (event));
+
+  switch (GST_EVENT_TYPE (event)) {
+    case GST_EVENT_NEWSEGMENT:
+      /* upstream talks bytes, we send our own time segment */
+      gst_event_unref (event);
+      res = TRUE;
+      break;
+    case GST_EVENT_EOS:
+      if (lrc->binary) {
+        if (!gst_lrc_demux_read_binary (lrc)) {
+          gst_event_unref (event);
+          res = FALSE;
+          break;
+        }
+      } else if (!lrc->probe) {
+        text = gst_lrc_converter_finish (&lrc->converter, &len);
+        gst_lrc_line_scanner_feed (&lrc->scanner, text, len);
+        while (gst_lrc_line_scanner_next (&lrc->scanner, &line, &linelen))
+          gst_lrc_demux_queue_line (lrc, line, linelen);
+        if (gst_lrc_line_scanner_finish (&lrc->scanner, &line, &linelen))
+          gst_lrc_demux_queue_line (lrc, line, linelen);
+      }
+      /* fail the same way as in pull mode, downstream still gets EOS */
+      if (!lrc->probe) {
+        if (!lrc->sniffed)
+          gst_lrc_demux_read_failed (lrc, GST_FLOW_UNEXPECTED);
+        else
+          gst_lrc_demux_check_cues (lrc, lrc->n_cues);
+      }
+      gst_lrc_demux_push_pending (lrc, GST_CLOCK_TIME_NONE);
+      gst_lrc_demux_start_stream (lrc);
+      res = gst_pad_push_event (lrc->srcpad, event);
+      break;
+    case GST_EVENT_FLUSH_STOP:
+      gst_lrc_demux_reset_stream (lrc);
+      gst_segment_init (&lrc->segment, GST_FORMAT_TIME);
+      res = gst_pad_push_event (lrc->srcpad, event);
+      break;
+    default:
+      res = gst_pad_event_default (pad, event);
+      break;
+  }
+
+  gst_object_unref (lrc);
+  return res;
+}
+
 static gboolean
 gst_lrc_demux_sink_activate (GstPad * sinkpad)
 {
@@ -400,6 +1641,10 @@ gst_lrc_demux_change_state (GstElement * element, GstStateChange transition)
 
   switch (transition) {
     case GST_STATE_CHANGE_READY_TO_PAUSED:
+      gst_segment_init (&lrc->segment, GST_FORMAT_TIME);
+      lrc->segment_running = FALSE;
+      gst_lrc_converter_clear (&lrc->converter);
+      gst_lrc_demux_init_converter (lrc, &lrc->converter);
       break;
     default:
       break;
@@ -411,7 +1656,36 @@ gst_lrc_demux_change_state (GstElement * element, GstStateChange transition)
 
   switch (transition) {
     case GST_STATE_CHANGE_PAUSED_TO_READY:
+      if (lrc->close_seg_event) {
+        gst_event_unref (lrc->close_seg_event);
+        lrc->close_seg_event = NULL;
+      }
+      if (lrc->new_seg_event) {
+        gst_event_unref (lrc->new_seg_event);
+        lrc->new_seg_event = NULL;
+      }
+      gst_lrc_demux_reset_stream (lrc);
+
+      /* the element may be reused for the next file */
+      if (lrc->index) {
+        gst_lrc_index_unref (lrc->index);
+        lrc->index = NULL;
+      }
+      lrc->cue = 0;
+      lrc->parsed = FALSE;
+      gst_lrc_demux_clear_lazy (lrc);
 
+      GST_OBJECT_LOCK (lrc);
+      g_free (lrc->title);
+      lrc->title = NULL;
+      g_free (lrc->artist);
+      lrc->artist = NULL;
+      g_free (lrc->album);
+      lrc->album = NULL;
+      g_free (lrc->creator);
+      lrc->creator = NULL;
+      lrc->offset = 0;
+      GST_OBJECT_UNLOCK (lrc);
       break;
     default:
       break;
@@ -21,6 +21,9 @@
 #define __GST_LRC_DEMUX_H__
 
 #include <gst/gst.h>
+#include <gst/base/gstadapter.h>
+#include "gstlrcparse.h"
+#include "gstlrccharset.h"
 
 G_BEGIN_DECLS
 
@@ -36,6 +39,9 @@ G_BEGIN_DECLS
   (G_TYPE_CHECK_CLASS_TYPE ((klass), GST_TYPE_LRC_DEMUX))
 
 #define LRC_BLOCK_SIZE 50
+#define LRC_PULL_BLOCK_SIZE (64 * 1024)
+#define LRC_PROBE_BLOCK_SIZE 4096
+#define LRC_LAZY_WINDOW (16 * 1024)
 
 typedef struct _GstLrcDemux {
   GstElement     parent;
@@ -51,10 +57,43 @@ typedef struct _GstLrcDemux {
   gchar* album;
   gchar* creator;
   gint offset;
+  gboolean use_cache;
+  gboolean probe;
+  gchar* charset;
+  guint parse_threads;
+  gboolean lazy_text;
   
   /* private data */
-  GList *lyricList;
+  GstLrcParser parser;
+  GstLrcIndex *index;
+  guint cue;
   gboolean parsed;
+  gboolean tags_sent;
+
+  /* lazy text: the converter from the charset of the source, set while
+   * the index only locates the lines, and the part of the source read
+   * last */
+  GstLrcConverter *lazy_conv;
+  GstBuffer *window;
+  guint64 window_offset;
+
+  GstSegment segment;
+  gboolean segment_running;
+  GstEvent *close_seg_event;
+  GstEvent *new_seg_event;
+
+  /* push mode */
+  GstLrcConverter converter;
+  GstLrcLineScanner scanner;
+  GQueue *pending;
+  GstClockTime watermark;
+  gboolean probed;
+  guint n_cues;                 /* queued in this stream */
+
+  /* a binary index is collected and read at the end of the stream,
+   * sniffed tells that the first buffer was checked for its magic */
+  GstAdapter *binary;
+  gboolean sniffed;
 } GstLrcDemux;
 
 typedef struct _GstLrcDemuxClass {
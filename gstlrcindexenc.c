@@ -0,0 +1,267 @@
+/* GStreamer
+ * Copyright (C) <2008> Zhao Liang <zlweb@163.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+
+/**
+ * SECTION:element-lrcindexenc
+ *
+ * <refsect2>
+ * <para>
+ * Parses a complete .lrc file and writes it out in the precompiled binary
+ * form that lrcdemux loads without parsing.
+ * </para>
+ * <title>Example launch line</title>
+ * <para>
+ * <programlisting>
+ * gst-launch filesrc location=test.lrc ! lrcindexenc ! filesink location=test.lrci
+ * </programlisting>
+ * </para>
+ * </refsect2>
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "gstlrcindexenc.h"
+#include "gstlrcbinary.h"
+#include "gstlrccharset.h"
+
+GST_DEBUG_CATEGORY_STATIC (lrcindexenc_debug);
+#define GST_CAT_DEFAULT lrcindexenc_debug
+
+static GstStaticPadTemplate srctemplate = GST_STATIC_PAD_TEMPLATE ("src",
+    GST_PAD_SRC,
+    GST_PAD_ALWAYS,
+    GST_STATIC_CAPS (LRC_BINARY_CAPS)
+    );
+
+static GstStaticPadTemplate sinktemplate = GST_STATIC_PAD_TEMPLATE ("sink",
+    GST_PAD_SINK,
+    GST_PAD_ALWAYS,
+    GST_STATIC_CAPS_ANY
+    );
+
+static void gst_lrc_index_enc_base_init (GstLrcIndexEncClass * klass);
+static void gst_lrc_index_enc_class_init (GstLrcIndexEncClass * klass);
+static void gst_lrc_index_enc_init (GstLrcIndexEnc * enc,
+    GstLrcIndexEncClass * gclass);
+static void gst_lrc_index_enc_finalize (GObject * object);
+
+static GstFlowReturn gst_lrc_index_enc_chain (GstPad * pad, GstBuffer * buf);
+static gboolean gst_lrc_index_enc_sink_event (GstPad * pad, GstEvent * event);
+
+static GstStateChangeReturn gst_lrc_index_enc_change_state (GstElement *
+    element, GstStateChange transition);
+
+static GstElementClass *parent_class = NULL;
+
+/* GObject methods */
+
+GType
+gst_lrc_index_enc_get_type (void)
+{
+  static GType lrc_index_enc_type = 0;
+
+  if (!lrc_index_enc_type) {
+    static const GTypeInfo lrc_index_enc_info = {
+      sizeof (GstLrcIndexEncClass),
+      (GBaseInitFunc) gst_lrc_index_enc_base_init,
+      NULL,
+      (GClassInitFunc) gst_lrc_index_enc_class_init,
+      NULL,
+      NULL,
+      sizeof (GstLrcIndexEnc),
+      0,
+      (GInstanceInitFunc) gst_lrc_index_enc_init,
+    };
+
+    lrc_index_enc_type =
+        g_type_register_static (GST_TYPE_ELEMENT,
+        "GstLrcIndexEnc", &lrc_index_enc_info, 0);
+  }
+
+  return lrc_index_enc_type;
+}
+
+static void
+gst_lrc_index_enc_base_init (GstLrcIndexEncClass * klass)
+{
+  static const GstElementDetails gst_lrc_index_enc_details =
+      GST_ELEMENT_DETAILS ("lrc index encoder",
+      "Codec/Encoder",
+      "Precompile a lrc file into a binary index",
+      "Zhao Liang <zlweb@163.com>");
+  GstElementClass *element_class = GST_ELEMENT_CLASS (klass);
+
+  gst_element_class_set_details (element_class, &gst_lrc_index_enc_details);
+}
+
+static void
+gst_lrc_index_enc_class_init (GstLrcIndexEncClass * klass)
+{
+  GstElementClass *gstelement_class = GST_ELEMENT_CLASS (klass);
+  GObjectClass *gobject_class = (GObjectClass *) klass;
+
+  GST_DEBUG_CATEGORY_INIT (lrcindexenc_debug, "lrcindexenc",
+      0, "Binary index writer for lrc files");
+
+  parent_class = g_type_class_peek_parent (klass);
+
+  gst_element_class_add_pad_template (gstelement_class,
+      gst_static_pad_template_get (&srctemplate));
+  gst_element_class_add_pad_template (gstelement_class,
+      gst_static_pad_template_get (&sinktemplate));
+
+  gobject_class->finalize = gst_lrc_index_enc_finalize;
+  gstelement_class->change_state =
+      GST_DEBUG_FUNCPTR (gst_lrc_index_enc_change_state);
+}
+
+static void
+gst_lrc_index_enc_init (GstLrcIndexEnc * enc, GstLrcIndexEncClass * gclass)
+{
+  enc->sinkpad = gst_pad_new_from_static_template (&sinktemplate, "sink");
+  gst_pad_set_chain_function (enc->sinkpad,
+      GST_DEBUG_FUNCPTR (gst_lrc_index_enc_chain));
+  gst_pad_set_event_function (enc->sinkpad,
+      GST_DEBUG_FUNCPTR (gst_lrc_index_enc_sink_event));
+  gst_element_add_pad (GST_ELEMENT (enc), enc->sinkpad);
+
+  enc->srcpad = gst_pad_new_from_static_template (&srctemplate, "src");
+  gst_pad_use_fixed_caps (enc->srcpad);
+  gst_element_add_pad (GST_ELEMENT (enc), enc->srcpad);
+
+  enc->adapter = gst_adapter_new ();
+}
+
+static void
+gst_lrc_index_enc_finalize (GObject * object)
+{
+  GstLrcIndexEnc *enc = GST_LRC_INDEX_ENC (object);
+
+  g_object_unref (enc->adapter);
+
+  G_OBJECT_CLASS (parent_class)->finalize (object);
+}
+
+/* the whole file is needed before the cues can be sorted */
+static GstFlowReturn
+gst_lrc_index_enc_chain (GstPad * pad, GstBuffer * buf)
+{
+  GstLrcIndexEnc *enc = GST_LRC_INDEX_ENC (GST_PAD_PARENT (pad));
+
+  gst_adapter_push (enc->adapter, buf);
+  return GST_FLOW_OK;
+}
+
+static GstFlowReturn
+gst_lrc_index_enc_write (GstLrcIndexEnc * enc)
+{
+  GstLrcParser parser;
+  GstLrcConverter conv;
+  GstLrcIndex *index;
+  GstBuffer *buf;
+  GstCaps *caps;
+  const gchar *text;
+  gsize len;
+  guint avail;
+
+  avail = gst_adapter_available (enc->adapter);
+
+  /* the index holds UTF-8 text like the cues of lrcdemux */
+  gst_lrc_parser_init (&parser);
+  if (avail > 0) {
+    gst_lrc_converter_init (&conv, NULL);
+    text = gst_lrc_converter_convert_all (&conv,
+        (const gchar *) gst_adapter_peek (enc->adapter, avail), avail, &len);
+    gst_lrc_parser_parse (&parser, text, len);
+    gst_lrc_converter_clear (&conv);
+  }
+  index = gst_lrc_parser_finish (&parser);
+  gst_lrc_parser_clear (&parser);
+  gst_adapter_clear (enc->adapter);
+
+  GST_DEBUG_OBJECT (enc, "%u bytes of lyrics, %u cues", avail, index->n_cues);
+
+  buf = gst_lrc_binary_write (index);
+  gst_lrc_index_unref (index);
+
+  caps = gst_caps_new_simple (LRC_BINARY_CAPS, NULL);
+  gst_pad_set_caps (enc->srcpad, caps);
+  gst_buffer_set_caps (buf, caps);
+  gst_caps_unref (caps);
+
+  gst_pad_push_event (enc->srcpad, gst_event_new_new_segment (FALSE, 1.0,
+          GST_FORMAT_BYTES, 0, -1, 0));
+  GST_BUFFER_OFFSET (buf) = 0;
+
+  return gst_pad_push (enc->srcpad, buf);
+}
+
+static gboolean
+gst_lrc_index_enc_sink_event (GstPad * pad, GstEvent * event)
+{
+  GstLrcIndexEnc *enc = GST_LRC_INDEX_ENC (gst_pad_get_parent (pad));
+  gboolean res;
+
+  switch (GST_EVENT_TYPE (event)) {
+    case GST_EVENT_NEWSEGMENT:
+      /* we send our own segment with the index */
+      gst_event_unref (event);
+      res = TRUE;
+      break;
+    case GST_EVENT_EOS:
+      gst_lrc_index_enc_write (enc);
+      res = gst_pad_push_event (enc->srcpad, event);
+      break;
+    case GST_EVENT_FLUSH_STOP:
+      gst_adapter_clear (enc->adapter);
+      res = gst_pad_push_event (enc->srcpad, event);
+      break;
+    default:
+      res = gst_pad_event_default (pad, event);
+      break;
+  }
+
+  gst_object_unref (enc);
+  return res;
+}
+
+static GstStateChangeReturn
+gst_lrc_index_enc_change_state (GstElement * element,
+    GstStateChange transition)
+{
+  GstStateChangeReturn ret;
+  GstLrcIndexEnc *enc = GST_LRC_INDEX_ENC (element);
+
+  ret = GST_ELEMENT_CLASS (parent_class)->change_state (element, transition);
+  if (ret == GST_STATE_CHANGE_FAILURE)
+    return ret;
+
+  switch (transition) {
+    case GST_STATE_CHANGE_PAUSED_TO_READY:
+      gst_adapter_clear (enc->adapter);
+      break;
+    default:
+      break;
+  }
+
+  return ret;
+}
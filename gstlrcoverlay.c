@@ -0,0 +1,738 @@
+/* GStreamer
+ * Copyright (C) <2008> Zhao Liang <zlweb@163.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+
+/**
+ * SECTION:element-lrcoverlay
+ *
+ * <refsect2>
+ * <para>
+ * Renders the lyrics from lrcdemux on top of a video stream. Each line is
+ * laid out and rasterized once, on a separate thread, as soon as it arrives
+ * ahead of its time; the video thread only blends the finished image into
+ * the frames while the line is showing.
+ * </para>
+ * <title>Example launch line</title>
+ * <para>
+ * <programlisting>
+ * gst-launch filesrc location=test.lrc ! lrcdemux ! overlay.text_sink videotestsrc ! ffmpegcolorspace ! lrcoverlay name=overlay ! ffmpegcolorspace ! autovideosink
+ * </programlisting>
+ * </para>
+ * </refsect2>
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <string.h>
+#include <gst/video/video.h>
+#include <pango/pangocairo.h>
+#include "gstlrcoverlay.h"
+#include "gstlrcparse.h"
+
+GST_DEBUG_CATEGORY_STATIC (lrcoverlay_debug);
+#define GST_CAT_DEFAULT lrcoverlay_debug
+
+enum
+{
+  PROP_0,
+  PROP_FONT_DESC
+};
+
+#define DEFAULT_FONT_DESC "Sans Bold 24"
+
+/* width of the dark outline around the text, in pixels */
+#define LRC_OVERLAY_OUTLINE 2
+
+/* cairo ARGB32 is native endian, the frames use the same byte order */
+#if G_BYTE_ORDER == G_LITTLE_ENDIAN
+#define LRC_OVERLAY_VIDEO_CAPS GST_VIDEO_CAPS_BGRx
+#define LRC_OVERLAY_ALPHA 3
+#else
+#define LRC_OVERLAY_VIDEO_CAPS GST_VIDEO_CAPS_xRGB
+#define LRC_OVERLAY_ALPHA 0
+#endif
+
+static GstStaticPadTemplate srctemplate = GST_STATIC_PAD_TEMPLATE ("src",
+    GST_PAD_SRC,
+    GST_PAD_ALWAYS,
+    GST_STATIC_CAPS (LRC_OVERLAY_VIDEO_CAPS)
+    );
+
+static GstStaticPadTemplate videotemplate =
+GST_STATIC_PAD_TEMPLATE ("video_sink",
+    GST_PAD_SINK,
+    GST_PAD_ALWAYS,
+    GST_STATIC_CAPS (LRC_OVERLAY_VIDEO_CAPS)
+    );
+
+static GstStaticPadTemplate texttemplate = GST_STATIC_PAD_TEMPLATE ("text_sink",
+    GST_PAD_SINK,
+    GST_PAD_ALWAYS,
+    GST_STATIC_CAPS ("text/lrc")
+    );
+
+static void gst_lrc_overlay_base_init (GstLrcOverlayClass * klass);
+static void gst_lrc_overlay_class_init (GstLrcOverlayClass * klass);
+static void gst_lrc_overlay_init (GstLrcOverlay * overlay,
+    GstLrcOverlayClass * gclass);
+static void gst_lrc_overlay_finalize (GObject * object);
+static void gst_lrc_overlay_set_property (GObject * object, guint prop_id,
+    const GValue * value, GParamSpec * pspec);
+static void gst_lrc_overlay_get_property (GObject * object, guint prop_id,
+    GValue * value, GParamSpec * pspec);
+
+static gboolean gst_lrc_overlay_video_setcaps (GstPad * pad, GstCaps * caps);
+static GstFlowReturn gst_lrc_overlay_video_chain (GstPad * pad,
+    GstBuffer * buf);
+static gboolean gst_lrc_overlay_video_event (GstPad * pad, GstEvent * event);
+static GstFlowReturn gst_lrc_overlay_text_chain (GstPad * pad,
+    GstBuffer * buf);
+static gboolean gst_lrc_overlay_text_event (GstPad * pad, GstEvent * event);
+static gboolean gst_lrc_overlay_src_event (GstPad * pad, GstEvent * event);
+
+static GstStateChangeReturn gst_lrc_overlay_change_state (GstElement *
+    element, GstStateChange transition);
+
+static GstElementClass *parent_class = NULL;
+
+/* GObject methods */
+
+GType
+gst_lrc_overlay_get_type (void)
+{
+  static GType lrc_overlay_type = 0;
+
+  if (!lrc_overlay_type) {
+    static const GTypeInfo lrc_overlay_info = {
+      sizeof (GstLrcOverlayClass),
+      (GBaseInitFunc) gst_lrc_overlay_base_init,
+      NULL,
+      (GClassInitFunc) gst_lrc_overlay_class_init,
+      NULL,
+      NULL,
+      sizeof (GstLrcOverlay),
+      0,
+      (GInstanceInitFunc) gst_lrc_overlay_init,
+    };
+
+    lrc_overlay_type =
+        g_type_register_static (GST_TYPE_ELEMENT,
+        "GstLrcOverlay", &lrc_overlay_info, 0);
+  }
+
+  return lrc_overlay_type;
+}
+
+static void
+gst_lrc_overlay_base_init (GstLrcOverlayClass * klass)
+{
+  static const GstElementDetails gst_lrc_overlay_details =
+      GST_ELEMENT_DETAILS ("lrc overlay",
+      "Filter/Editor/Video",
+      "Render lyrics on top of a video stream",
+      "Zhao Liang <zlweb@163.com>");
+  GstElementClass *element_class = GST_ELEMENT_CLASS (klass);
+
+  gst_element_class_set_details (element_class, &gst_lrc_overlay_details);
+}
+
+static void
+gst_lrc_overlay_class_init (GstLrcOverlayClass * klass)
+{
+  GstElementClass *gstelement_class = GST_ELEMENT_CLASS (klass);
+  GObjectClass *gobject_class = (GObjectClass *) klass;
+
+  GST_DEBUG_CATEGORY_INIT (lrcoverlay_debug, "lrcoverlay",
+      0, "Lyrics overlay");
+
+  parent_class = g_type_class_peek_parent (klass);
+
+  gst_element_class_add_pad_template (gstelement_class,
+      gst_static_pad_template_get (&srctemplate));
+  gst_element_class_add_pad_template (gstelement_class,
+      gst_static_pad_template_get (&videotemplate));
+  gst_element_class_add_pad_template (gstelement_class,
+      gst_static_pad_template_get (&texttemplate));
+
+  gobject_class->finalize = gst_lrc_overlay_finalize;
+  gobject_class->set_property = gst_lrc_overlay_set_property;
+  gobject_class->get_property = gst_lrc_overlay_get_property;
+
+  g_object_class_install_property (gobject_class, PROP_FONT_DESC,
+      g_param_spec_string ("font-desc", "Font description",
+          "Pango font description of the lyrics, used for the lines "
+          "rendered after a change", DEFAULT_FONT_DESC, G_PARAM_READWRITE));
+
+  gstelement_class->change_state =
+      GST_DEBUG_FUNCPTR (gst_lrc_overlay_change_state);
+}
+
+static void
+gst_lrc_overlay_init (GstLrcOverlay * overlay, GstLrcOverlayClass * gclass)
+{
+  overlay->video_sinkpad =
+      gst_pad_new_from_static_template (&videotemplate, "video_sink");
+  gst_pad_set_getcaps_function (overlay->video_sinkpad,
+      GST_DEBUG_FUNCPTR (gst_pad_proxy_getcaps));
+  gst_pad_set_setcaps_function (overlay->video_sinkpad,
+      GST_DEBUG_FUNCPTR (gst_lrc_overlay_video_setcaps));
+  gst_pad_set_chain_function (overlay->video_sinkpad,
+      GST_DEBUG_FUNCPTR (gst_lrc_overlay_video_chain));
+  gst_pad_set_event_function (overlay->video_sinkpad,
+      GST_DEBUG_FUNCPTR (gst_lrc_overlay_video_event));
+  gst_element_add_pad (GST_ELEMENT (overlay), overlay->video_sinkpad);
+
+  overlay->text_sinkpad =
+      gst_pad_new_from_static_template (&texttemplate, "text_sink");
+  gst_pad_set_chain_function (overlay->text_sinkpad,
+      GST_DEBUG_FUNCPTR (gst_lrc_overlay_text_chain));
+  gst_pad_set_event_function (overlay->text_sinkpad,
+      GST_DEBUG_FUNCPTR (gst_lrc_overlay_text_event));
+  gst_element_add_pad (GST_ELEMENT (overlay), overlay->text_sinkpad);
+
+  overlay->srcpad = gst_pad_new_from_static_template (&srctemplate, "src");
+  gst_pad_set_getcaps_function (overlay->srcpad,
+      GST_DEBUG_FUNCPTR (gst_pad_proxy_getcaps));
+  gst_pad_set_event_function (overlay->srcpad,
+      GST_DEBUG_FUNCPTR (gst_lrc_overlay_src_event));
+  gst_element_add_pad (GST_ELEMENT (overlay), overlay->srcpad);
+
+  overlay->font_desc = g_strdup (DEFAULT_FONT_DESC);
+  overlay->width = 0;
+  overlay->height = 0;
+  gst_segment_init (&overlay->video_segment, GST_FORMAT_TIME);
+  gst_segment_init (&overlay->text_segment, GST_FORMAT_TIME);
+
+#if GLIB_CHECK_VERSION (2, 32, 0)
+  overlay->lock = g_new (GMutex, 1);
+  g_mutex_init (overlay->lock);
+  overlay->cond = g_new (GCond, 1);
+  g_cond_init (overlay->cond);
+#else
+  overlay->lock = g_mutex_new ();
+  overlay->cond = g_cond_new ();
+#endif
+  overlay->lines = g_queue_new ();
+  overlay->text_flushing = FALSE;
+  overlay->running = FALSE;
+  overlay->thread = NULL;
+}
+
+static void
+gst_lrc_overlay_line_free (GstLrcOverlayLine * line)
+{
+  if (line->surface)
+    cairo_surface_destroy (line->surface);
+  g_free (line->text);
+  g_slice_free (GstLrcOverlayLine, line);
+}
+
+/* take a line out of use, with the lock held. The render thread frees a
+ * line it is still working on itself. */
+static void
+gst_lrc_overlay_line_release (GstLrcOverlayLine * line)
+{
+  if (line->busy)
+    line->dropped = TRUE;
+  else
+    gst_lrc_overlay_line_free (line);
+}
+
+static void
+gst_lrc_overlay_clear_lines (GstLrcOverlay * overlay)
+{
+  GstLrcOverlayLine *line;
+
+  while ((line = g_queue_pop_head (overlay->lines)))
+    gst_lrc_overlay_line_release (line);
+  g_cond_broadcast (overlay->cond);
+}
+
+static void
+gst_lrc_overlay_finalize (GObject * object)
+{
+  GstLrcOverlay *overlay = GST_LRC_OVERLAY (object);
+
+  GST_DEBUG ("lrc: finalize");
+
+  gst_lrc_overlay_clear_lines (overlay);
+  g_queue_free (overlay->lines);
+#if GLIB_CHECK_VERSION (2, 32, 0)
+  g_cond_clear (overlay->cond);
+  g_free (overlay->cond);
+  g_mutex_clear (overlay->lock);
+  g_free (overlay->lock);
+#else
+  g_cond_free (overlay->cond);
+  g_mutex_free (overlay->lock);
+#endif
+  g_free (overlay->font_desc);
+
+  G_OBJECT_CLASS (parent_class)->finalize (object);
+}
+
+static void
+gst_lrc_overlay_set_property (GObject * object, guint prop_id,
+    const GValue * value, GParamSpec * pspec)
+{
+  GstLrcOverlay *overlay = GST_LRC_OVERLAY (object);
+
+  switch (prop_id) {
+    case PROP_FONT_DESC:
+      GST_OBJECT_LOCK (overlay);
+      g_free (overlay->font_desc);
+      overlay->font_desc = g_value_dup_string (value);
+      GST_OBJECT_UNLOCK (overlay);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+      break;
+  }
+}
+
+static void
+gst_lrc_overlay_get_property (GObject * object, guint prop_id, GValue * value,
+    GParamSpec * pspec)
+{
+  GstLrcOverlay *overlay = GST_LRC_OVERLAY (object);
+
+  switch (prop_id) {
+    case PROP_FONT_DESC:
+      GST_OBJECT_LOCK (overlay);
+      g_value_set_string (value, overlay->font_desc);
+      GST_OBJECT_UNLOCK (overlay);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+      break;
+  }
+}
+
+/* lay out and draw one line, white with a dark outline */
+static void
+gst_lrc_overlay_rasterize (GstLrcOverlay * overlay, PangoLayout * layout,
+    GstLrcOverlayLine * line)
+{
+  PangoFontDescription *desc;
+  cairo_surface_t *surface;
+  cairo_t *cr;
+  gint width, height, max_width;
+
+  GST_OBJECT_LOCK (overlay);
+  desc = pango_font_description_from_string (overlay->font_desc ?
+      overlay->font_desc : DEFAULT_FONT_DESC);
+  max_width = overlay->width - 2 * LRC_OVERLAY_OUTLINE;
+  GST_OBJECT_UNLOCK (overlay);
+
+  pango_layout_set_font_description (layout, desc);
+  pango_font_description_free (desc);
+  pango_layout_set_width (layout, max_width > 0 ? max_width * PANGO_SCALE :
+      -1);
+  pango_layout_set_text (layout, line->text, -1);
+  pango_layout_get_pixel_size (layout, &width, &height);
+
+  surface = cairo_image_surface_create (CAIRO_FORMAT_ARGB32,
+      width + 2 * LRC_OVERLAY_OUTLINE, height + 2 * LRC_OVERLAY_OUTLINE);
+  cr = cairo_create (surface);
+  cairo_translate (cr, LRC_OVERLAY_OUTLINE, LRC_OVERLAY_OUTLINE);
+
+  pango_cairo_layout_path (cr, layout);
+  cairo_set_source_rgba (cr, 0.0, 0.0, 0.0, 1.0);
+  cairo_set_line_width (cr, 2 * LRC_OVERLAY_OUTLINE);
+  cairo_set_line_join (cr, CAIRO_LINE_JOIN_ROUND);
+  cairo_stroke (cr);
+
+  cairo_move_to (cr, 0, 0);
+  cairo_set_source_rgba (cr, 1.0, 1.0, 1.0, 1.0);
+  pango_cairo_show_layout (cr, layout);
+
+  cairo_destroy (cr);
+  cairo_surface_flush (surface);
+
+  GST_LOG_OBJECT (overlay, "rasterized %dx%d for %" GST_TIME_FORMAT, width,
+      height, GST_TIME_ARGS (line->start));
+  line->surface = surface;
+}
+
+/* Rasterizes the queued lines in time order, well before the video gets
+ * to them. The pango objects belong to this thread. */
+static gpointer
+gst_lrc_overlay_render_loop (gpointer data)
+{
+  GstLrcOverlay *overlay = GST_LRC_OVERLAY (data);
+  PangoContext *context;
+  PangoLayout *layout;
+  GstLrcOverlayLine *line;
+  GList *l;
+
+  context = pango_cairo_font_map_create_context (PANGO_CAIRO_FONT_MAP
+      (pango_cairo_font_map_get_default ()));
+  layout = pango_layout_new (context);
+  pango_layout_set_alignment (layout, PANGO_ALIGN_CENTER);
+
+  g_mutex_lock (overlay->lock);
+  while (overlay->running) {
+    line = NULL;
+    for (l = overlay->lines->head; l; l = l->next) {
+      if (!((GstLrcOverlayLine *) l->data)->surface) {
+        line = l->data;
+        break;
+      }
+    }
+    if (!line) {
+      g_cond_wait (overlay->cond, overlay->lock);
+      continue;
+    }
+
+    line->busy = TRUE;
+    g_mutex_unlock (overlay->lock);
+
+    gst_lrc_overlay_rasterize (overlay, layout, line);
+
+    g_mutex_lock (overlay->lock);
+    line->busy = FALSE;
+    if (line->dropped)
+      gst_lrc_overlay_line_free (line);
+  }
+  g_mutex_unlock (overlay->lock);
+
+  g_object_unref (layout);
+  g_object_unref (context);
+  return NULL;
+}
+
+/* Premultiplied source over the frame. There are no branches so that the
+ * compiler can vectorize the loops, the padding byte of the frame is
+ * blended like the colors and ignored downstream. */
+static void
+gst_lrc_overlay_blend (guint8 * dst, gint dst_stride, const guint8 * src,
+    gint src_stride, gint width, gint height)
+{
+  gint x, y, c;
+  guint a;
+
+  for (y = 0; y < height; y++) {
+    for (x = 0; x < width * 4; x += 4) {
+      a = 255 - src[x + LRC_OVERLAY_ALPHA];
+      for (c = 0; c < 4; c++)
+        dst[x + c] = src[x + c] + (((dst[x + c] * a + 128) * 257) >> 16);
+    }
+    dst += dst_stride;
+    src += src_stride;
+  }
+}
+
+/* bottom centre of the frame, cut to the frame size */
+static void
+gst_lrc_overlay_blend_line (GstLrcOverlay * overlay, GstLrcOverlayLine * line,
+    GstBuffer * buf)
+{
+  const guint8 *src;
+  guint8 *dst;
+  gint width, height, x, y, src_x, stride;
+
+  stride = overlay->width * 4;
+  if (GST_BUFFER_SIZE (buf) < stride * overlay->height)
+    return;
+
+  width = cairo_image_surface_get_width (line->surface);
+  height = cairo_image_surface_get_height (line->surface);
+  src = cairo_image_surface_get_data (line->surface);
+
+  x = (overlay->width - width) / 2;
+  y = overlay->height - height - overlay->height / 20;
+  src_x = 0;
+  if (x < 0) {
+    src_x = -x;
+    width = overlay->width;
+    x = 0;
+  }
+  if (y < 0) {
+    src += -y * cairo_image_surface_get_stride (line->surface);
+    height += y;
+    y = 0;
+  }
+  if (width <= 0 || height <= 0)
+    return;
+
+  dst = GST_BUFFER_DATA (buf) + y * stride + x * 4;
+  gst_lrc_overlay_blend (dst, stride, src + src_x * 4,
+      cairo_image_surface_get_stride (line->surface), width, height);
+}
+
+static gboolean
+gst_lrc_overlay_video_setcaps (GstPad * pad, GstCaps * caps)
+{
+  GstLrcOverlay *overlay = GST_LRC_OVERLAY (gst_pad_get_parent (pad));
+  GstStructure *s = gst_caps_get_structure (caps, 0);
+  gint width, height;
+  gboolean res = FALSE;
+
+  if (gst_structure_get_int (s, "width", &width) &&
+      gst_structure_get_int (s, "height", &height) &&
+      gst_pad_set_caps (overlay->srcpad, caps)) {
+    GST_OBJECT_LOCK (overlay);
+    overlay->width = width;
+    overlay->height = height;
+    GST_OBJECT_UNLOCK (overlay);
+    res = TRUE;
+  }
+
+  gst_object_unref (overlay);
+  return res;
+}
+
+static GstFlowReturn
+gst_lrc_overlay_video_chain (GstPad * pad, GstBuffer * buf)
+{
+  GstLrcOverlay *overlay = GST_LRC_OVERLAY (GST_PAD_PARENT (pad));
+  GstLrcOverlayLine *line, *next;
+  GstClockTime running;
+
+  if (!GST_BUFFER_TIMESTAMP_IS_VALID (buf))
+    goto push;
+  running = gst_segment_to_running_time (&overlay->video_segment,
+      GST_FORMAT_TIME, GST_BUFFER_TIMESTAMP (buf));
+  if (!GST_CLOCK_TIME_IS_VALID (running))
+    goto push;
+
+  g_mutex_lock (overlay->lock);
+
+  /* lines that are over make room for the text pad */
+  while ((line = g_queue_peek_head (overlay->lines))) {
+    next = g_queue_peek_nth (overlay->lines, 1);
+    if (!(GST_CLOCK_TIME_IS_VALID (line->stop) && line->stop <= running) &&
+        !(next && next->start <= running))
+      break;
+    g_queue_pop_head (overlay->lines);
+    gst_lrc_overlay_line_release (line);
+    g_cond_broadcast (overlay->cond);
+  }
+
+  /* a line that is not rasterized yet is skipped, video never waits */
+  if (line && line->start <= running && line->surface && !line->busy) {
+    buf = gst_buffer_make_writable (buf);
+    gst_lrc_overlay_blend_line (overlay, line, buf);
+  }
+
+  g_mutex_unlock (overlay->lock);
+
+push:
+  return gst_pad_push (overlay->srcpad, buf);
+}
+
+static gboolean
+gst_lrc_overlay_video_event (GstPad * pad, GstEvent * event)
+{
+  GstLrcOverlay *overlay = GST_LRC_OVERLAY (gst_pad_get_parent (pad));
+  GstFormat format;
+  gdouble rate;
+  gint64 start, stop, time;
+  gboolean update, res;
+
+  switch (GST_EVENT_TYPE (event)) {
+    case GST_EVENT_NEWSEGMENT:
+      gst_event_parse_new_segment (event, &update, &rate, &format, &start,
+          &stop, &time);
+      if (format == GST_FORMAT_TIME)
+        gst_segment_set_newsegment (&overlay->video_segment, update, rate,
+            format, start, stop, time);
+      break;
+    case GST_EVENT_FLUSH_STOP:
+      gst_segment_init (&overlay->video_segment, GST_FORMAT_TIME);
+      break;
+    default:
+      break;
+  }
+  res = gst_pad_event_default (pad, event);
+
+  gst_object_unref (overlay);
+  return res;
+}
+
+static GstFlowReturn
+gst_lrc_overlay_text_chain (GstPad * pad, GstBuffer * buf)
+{
+  GstLrcOverlay *overlay = GST_LRC_OVERLAY (GST_PAD_PARENT (pad));
+  GstLrcOverlayLine *line;
+  GstClockTime start, stop = GST_CLOCK_TIME_NONE;
+  const guint8 *nul;
+  gsize len;
+
+  if (!GST_BUFFER_TIMESTAMP_IS_VALID (buf))
+    goto done;
+  start = gst_segment_to_running_time (&overlay->text_segment,
+      GST_FORMAT_TIME, GST_BUFFER_TIMESTAMP (buf));
+  if (!GST_CLOCK_TIME_IS_VALID (start))
+    goto done;
+  if (GST_BUFFER_DURATION_IS_VALID (buf))
+    stop = gst_segment_to_running_time (&overlay->text_segment,
+        GST_FORMAT_TIME, GST_BUFFER_TIMESTAMP (buf) +
+        GST_BUFFER_DURATION (buf));
+
+  /* the text ends at the NUL, enhanced lrc word times follow it */
+  len = GST_BUFFER_SIZE (buf);
+  if ((nul = memchr (GST_BUFFER_DATA (buf), '\0', len)))
+    len = nul - GST_BUFFER_DATA (buf);
+  if (len == 0)
+    goto done;
+
+  line = g_slice_new0 (GstLrcOverlayLine);
+  line->start = start;
+  line->stop = stop;
+  line->text = g_strndup ((const gchar *) GST_BUFFER_DATA (buf), len);
+
+  g_mutex_lock (overlay->lock);
+  while (!overlay->text_flushing &&
+      g_queue_get_length (overlay->lines) >= LRC_OVERLAY_MAX_LINES)
+    g_cond_wait (overlay->cond, overlay->lock);
+
+  if (overlay->text_flushing) {
+    g_mutex_unlock (overlay->lock);
+    gst_lrc_overlay_line_free (line);
+    gst_buffer_unref (buf);
+    return GST_FLOW_WRONG_STATE;
+  }
+
+  g_queue_push_tail (overlay->lines, line);
+  g_cond_broadcast (overlay->cond);
+  g_mutex_unlock (overlay->lock);
+
+done:
+  gst_buffer_unref (buf);
+  return GST_FLOW_OK;
+}
+
+/* text events end here, the video stream carries the output */
+static gboolean
+gst_lrc_overlay_text_event (GstPad * pad, GstEvent * event)
+{
+  GstLrcOverlay *overlay = GST_LRC_OVERLAY (gst_pad_get_parent (pad));
+  GstFormat format;
+  gdouble rate;
+  gint64 start, stop, time;
+  gboolean update;
+
+  GST_DEBUG_OBJECT (overlay, "handling %s event",
+      GST_EVENT_TYPE_NAME (event));
+
+  switch (GST_EVENT_TYPE (event)) {
+    case GST_EVENT_NEWSEGMENT:
+      gst_event_parse_new_segment (event, &update, &rate, &format, &start,
+          &stop, &time);
+      if (format == GST_FORMAT_TIME)
+        gst_segment_set_newsegment (&overlay->text_segment, update, rate,
+            format, start, stop, time);
+      break;
+    case GST_EVENT_FLUSH_START:
+      g_mutex_lock (overlay->lock);
+      overlay->text_flushing = TRUE;
+      g_cond_broadcast (overlay->cond);
+      g_mutex_unlock (overlay->lock);
+      break;
+    case GST_EVENT_FLUSH_STOP:
+      g_mutex_lock (overlay->lock);
+      gst_lrc_overlay_clear_lines (overlay);
+      overlay->text_flushing = FALSE;
+      g_mutex_unlock (overlay->lock);
+      gst_segment_init (&overlay->text_segment, GST_FORMAT_TIME);
+      break;
+    default:
+      break;
+  }
+  gst_event_unref (event);
+
+  gst_object_unref (overlay);
+  return TRUE;
+}
+
+static gboolean
+gst_lrc_overlay_src_event (GstPad * pad, GstEvent * event)
+{
+  GstLrcOverlay *overlay = GST_LRC_OVERLAY (gst_pad_get_parent (pad));
+  gboolean res;
+
+  /* seeks go to the lyrics as well */
+  if (GST_EVENT_TYPE (event) == GST_EVENT_SEEK &&
+      gst_pad_is_linked (overlay->text_sinkpad))
+    gst_pad_push_event (overlay->text_sinkpad, gst_event_ref (event));
+
+  res = gst_pad_push_event (overlay->video_sinkpad, event);
+
+  gst_object_unref (overlay);
+  return res;
+}
+
+static GstStateChangeReturn
+gst_lrc_overlay_change_state (GstElement * element, GstStateChange transition)
+{
+  GstStateChangeReturn ret = GST_STATE_CHANGE_SUCCESS;
+  GstLrcOverlay *overlay = GST_LRC_OVERLAY (element);
+
+  switch (transition) {
+    case GST_STATE_CHANGE_READY_TO_PAUSED:
+      gst_segment_init (&overlay->video_segment, GST_FORMAT_TIME);
+      gst_segment_init (&overlay->text_segment, GST_FORMAT_TIME);
+      overlay->text_flushing = FALSE;
+      overlay->running = TRUE;
+      overlay->thread = gst_lrc_thread_new ("lrcoverlay",
+          gst_lrc_overlay_render_loop, overlay);
+      if (!overlay->thread) {
+        GST_ELEMENT_ERROR (overlay, RESOURCE, FAILED, (NULL),
+            ("could not start the render thread"));
+        return GST_STATE_CHANGE_FAILURE;
+      }
+      break;
+    case GST_STATE_CHANGE_PAUSED_TO_READY:
+      /* a text chain waiting for room must return */
+      g_mutex_lock (overlay->lock);
+      overlay->text_flushing = TRUE;
+      g_cond_broadcast (overlay->cond);
+      g_mutex_unlock (overlay->lock);
+      break;
+    default:
+      break;
+  }
+
+  ret = GST_ELEMENT_CLASS (parent_class)->change_state (element, transition);
+  if (ret == GST_STATE_CHANGE_FAILURE)
+    goto done;
+
+  switch (transition) {
+    case GST_STATE_CHANGE_PAUSED_TO_READY:
+      g_mutex_lock (overlay->lock);
+      overlay->running = FALSE;
+      g_cond_broadcast (overlay->cond);
+      g_mutex_unlock (overlay->lock);
+      g_thread_join (overlay->thread);
+      overlay->thread = NULL;
+
+      g_mutex_lock (overlay->lock);
+      gst_lrc_overlay_clear_lines (overlay);
+      g_mutex_unlock (overlay->lock);
+      break;
+    default:
+      break;
+  }
+
+done:
+  return ret;
+}
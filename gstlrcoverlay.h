@@ -0,0 +1,91 @@
+/* GStreamer
+ * Copyright (C) <2008> Zhao Liang <zlweb@163.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+
+#ifndef __GST_LRC_OVERLAY_H__
+#define __GST_LRC_OVERLAY_H__
+
+#include <gst/gst.h>
+#include <cairo.h>
+
+G_BEGIN_DECLS
+
+#define GST_TYPE_LRC_OVERLAY \
+  (gst_lrc_overlay_get_type ())
+#define GST_LRC_OVERLAY(obj) \
+  (G_TYPE_CHECK_INSTANCE_CAST ((obj), GST_TYPE_LRC_OVERLAY, GstLrcOverlay))
+#define GST_LRC_OVERLAY_CLASS(klass) \
+  (G_TYPE_CHECK_CLASS_CAST ((klass), GST_TYPE_LRC_OVERLAY, GstLrcOverlayClass))
+#define GST_IS_LRC_OVERLAY(obj) \
+  (G_TYPE_CHECK_INSTANCE_TYPE ((obj), GST_TYPE_LRC_OVERLAY))
+#define GST_IS_LRC_OVERLAY_CLASS(klass) \
+  (G_TYPE_CHECK_CLASS_TYPE ((klass), GST_TYPE_LRC_OVERLAY))
+
+/* lines received ahead of the video, the text pad blocks beyond this */
+#define LRC_OVERLAY_MAX_LINES 8
+
+/* One cue with its rasterized form. Times are running times. surface is
+ * NULL until the render thread is done with the line; while busy it
+ * belongs to that thread and is only marked dropped when it expires. */
+typedef struct _GstLrcOverlayLine {
+  GstClockTime   start;
+  GstClockTime   stop;
+  gchar         *text;
+
+  cairo_surface_t *surface;
+  gboolean       busy;
+  gboolean       dropped;
+} GstLrcOverlayLine;
+
+typedef struct _GstLrcOverlay {
+  GstElement     parent;
+
+  /* pads */
+  GstPad        *video_sinkpad;
+  GstPad        *text_sinkpad;
+  GstPad        *srcpad;
+
+  /* properity */
+  gchar         *font_desc;
+
+  /* video format */
+  gint           width;
+  gint           height;
+
+  GstSegment     video_segment;
+  GstSegment     text_segment;
+
+  /* the line cache, in time order, protected by lock */
+  GMutex        *lock;
+  GCond         *cond;
+  GQueue        *lines;
+  gboolean       text_flushing;
+  gboolean       running;
+  GThread       *thread;
+} GstLrcOverlay;
+
+typedef struct _GstLrcOverlayClass {
+  GstElementClass parent_class;
+} GstLrcOverlayClass;
+
+GType           gst_lrc_overlay_get_type (void);
+
+G_END_DECLS
+
+#endif /* __GST_LRC_OVERLAY_H__ */
@@ -0,0 +1,1274 @@
+/* GStreamer
+ * Copyright (C) <2008> Zhao Liang <zlweb@163.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "gstlrcparse.h"
+
+GST_DEBUG_CATEGORY (lrcparse_debug);
+#define GST_CAT_DEFAULT lrcparse_debug
+
+static const gchar *lrc_tag_names[GST_LRC_TAG_COUNT] = {
+  "ti", "ar", "al", "by", "re", "ve", "offset"
+};
+
+#define LRC_TAG_ID(a, b) (((a) << 8) | (b))
+
+void
+gst_lrc_line_scanner_init (GstLrcLineScanner * scanner)
+{
+  scanner->data = NULL;
+  scanner->size = 0;
+  scanner->pos = 0;
+  scanner->base = 0;
+  scanner->offset = 0;
+  scanner->lf = 0;
+  scanner->carry = g_byte_array_new ();
+  scanner->carry_used = FALSE;
+  scanner->skip_lf = FALSE;
+}
+
+void
+gst_lrc_line_scanner_clear (GstLrcLineScanner * scanner)
+{
+  if (scanner->carry)
+    g_byte_array_free (scanner->carry, TRUE);
+  scanner->carry = NULL;
+  scanner->data = NULL;
+  scanner->size = scanner->pos = scanner->lf = 0;
+}
+
+/* the data must stay valid until next() returned FALSE for it */
+void
+gst_lrc_line_scanner_feed (GstLrcLineScanner * scanner, const gchar * data,
+    gsize size)
+{
+  const gchar *lf = memchr (data, '\n', size);
+
+  scanner->base += scanner->size;
+  scanner->data = data;
+  scanner->size = size;
+  scanner->pos = 0;
+  scanner->lf = lf ? (gsize) (lf - data) : size;
+}
+
+/* find the end of the line starting at pos. The '\n' search is done by
+ * memchr over the whole chunk at most once, the '\r' search never goes
+ * past the next '\n', so CR-less and LF-less files both stay linear. */
+static const gchar *
+gst_lrc_line_scanner_find_eol (GstLrcLineScanner * scanner)
+{
+  const gchar *start = scanner->data + scanner->pos;
+  const gchar *lf;
+
+  if (scanner->lf < scanner->pos) {
+    lf = memchr (start, '\n', scanner->size - scanner->pos);
+    scanner->lf = lf ? (gsize) (lf - scanner->data) : scanner->size;
+  }
+
+  if (scanner->lf < scanner->size)
+    lf = scanner->data + scanner->lf;
+  else
+    lf = NULL;
+
+  start = memchr (start, '\r', (lf ? lf : scanner->data + scanner->size) -
+      start);
+  return start ? start : lf;
+}
+
+gboolean
+gst_lrc_line_scanner_next (GstLrcLineScanner * scanner, const gchar ** line,
+    gsize * len)
+{
+  const gchar *start;
+  const gchar *eol;
+
+  if (scanner->carry_used) {
+    g_byte_array_set_size (scanner->carry, 0);
+    scanner->carry_used = FALSE;
+  }
+
+  if (scanner->pos >= scanner->size)
+    return FALSE;
+
+  /* the previous chunk ended in '\r', drop the '\n' of a split "\r\n" */
+  if (scanner->skip_lf) {
+    scanner->skip_lf = FALSE;
+    if (scanner->data[scanner->pos] == '\n' && ++scanner->pos >= scanner->size)
+      return FALSE;
+  }
+
+  start = scanner->data + scanner->pos;
+  if (scanner->carry->len == 0)
+    scanner->offset = scanner->base + scanner->pos;
+  eol = gst_lrc_line_scanner_find_eol (scanner);
+  if (!eol) {
+    g_byte_array_append (scanner->carry, (const guint8 *) start,
+        scanner->size - scanner->pos);
+    scanner->pos = scanner->size;
+    return FALSE;
+  }
+
+  if (scanner->carry->len > 0) {
+    g_byte_array_append (scanner->carry, (const guint8 *) start, eol - start);
+    *line = (const gchar *) scanner->carry->data;
+    *len = scanner->carry->len;
+    scanner->carry_used = TRUE;
+  } else {
+    *line = start;
+    *len = eol - start;
+  }
+
+  scanner->pos = (eol - scanner->data) + 1;
+  if (*eol == '\r') {
+    if (scanner->pos >= scanner->size)
+      scanner->skip_lf = TRUE;
+    else if (scanner->data[scanner->pos] == '\n')
+      scanner->pos++;
+  }
+
+  return TRUE;
+}
+
+/* hand out the unterminated last line, if any, once all data was fed */
+gboolean
+gst_lrc_line_scanner_finish (GstLrcLineScanner * scanner, const gchar ** line,
+    gsize * len)
+{
+  if (scanner->carry_used) {
+    g_byte_array_set_size (scanner->carry, 0);
+    scanner->carry_used = FALSE;
+  }
+
+  if (scanner->carry->len == 0)
+    return FALSE;
+
+  *line = (const gchar *) scanner->carry->data;
+  *len = scanner->carry->len;
+  scanner->carry_used = TRUE;
+  return TRUE;
+}
+
+#define LRC_INTERN_MIN_SIZE 64
+
+void
+gst_lrc_intern_table_init (GstLrcInternTable * table)
+{
+  table->slots = NULL;
+  table->size = 0;
+  table->used = 0;
+}
+
+/* forget all strings but keep the slots for reuse */
+void
+gst_lrc_intern_table_reset (GstLrcInternTable * table)
+{
+  if (table->slots)
+    memset (table->slots, 0, table->size * sizeof (GstLrcInternSlot));
+  table->used = 0;
+}
+
+void
+gst_lrc_intern_table_clear (GstLrcInternTable * table)
+{
+  g_free (table->slots);
+  gst_lrc_intern_table_init (table);
+}
+
+/* FNV-1a */
+static guint32
+gst_lrc_intern_hash (const gchar * str, gsize len)
+{
+  guint32 hash = 2166136261U;
+  gsize i;
+
+  for (i = 0; i < len; i++) {
+    hash ^= (guchar) str[i];
+    hash *= 16777619U;
+  }
+  return hash;
+}
+
+static void
+gst_lrc_intern_table_grow (GstLrcInternTable * table)
+{
+  GstLrcInternSlot *old = table->slots;
+  guint old_size = table->size;
+  guint mask, i, j;
+
+  table->size = old_size ? old_size * 2 : LRC_INTERN_MIN_SIZE;
+  table->slots = g_new0 (GstLrcInternSlot, table->size);
+  mask = table->size - 1;
+
+  for (i = 0; i < old_size; i++) {
+    if (!old[i].offset)
+      continue;
+    for (j = old[i].hash & mask; table->slots[j].offset; j = (j + 1) & mask);
+    table->slots[j] = old[i];
+  }
+  g_free (old);
+}
+
+/* Return the offset of str in the text block, appending it with a
+ * terminator when it is not there yet. */
+guint32
+gst_lrc_intern_table_add (GstLrcInternTable * table, GByteArray * text,
+    const gchar * str, gsize len)
+{
+  GstLrcInternSlot *slot;
+  guint32 hash, offset;
+  guint mask, i;
+
+  if (table->used * 2 >= table->size)
+    gst_lrc_intern_table_grow (table);
+
+  hash = gst_lrc_intern_hash (str, len);
+  mask = table->size - 1;
+
+  for (i = hash & mask; table->slots[i].offset; i = (i + 1) & mask) {
+    slot = &table->slots[i];
+    offset = slot->offset - 1;
+    if (slot->hash == hash && offset + len < text->len &&
+        text->data[offset + len] == '\0' &&
+        memcmp (text->data + offset, str, len) == 0)
+      return offset;
+  }
+
+  offset = text->len;
+  g_byte_array_append (text, (const guint8 *) str, len);
+  g_byte_array_append (text, (const guint8 *) "", 1);
+
+  table->slots[i].hash = hash;
+  table->slots[i].offset = offset + 1;
+  table->used++;
+
+  return offset;
+}
+
+static gint
+gst_lrc_cue_compare (gconstpointer a, gconstpointer b)
+{
+  const GstLrcCue *ca = a;
+  const GstLrcCue *cb = b;
+
+  if (ca->start != cb->start)
+    return ca->start < cb->start ? -1 : 1;
+  if (ca->stop != cb->stop)
+    return ca->stop < cb->stop ? -1 : 1;
+
+  return 0;
+}
+
+/* Sort by timestamp, equal timestamps in file order. g_array_sort only
+ * keeps equal elements in order since GLib 2.32, so the order is made
+ * explicit: until the stops are set, a cue's stop holds its position. */
+static void
+gst_lrc_cues_order (GArray * cues)
+{
+  GstLrcCue *cue = (GstLrcCue *) cues->data;
+  guint i;
+
+  for (i = 0; i < cues->len; i++)
+    cue[i].stop = i;
+  g_array_sort (cues, gst_lrc_cue_compare);
+}
+
+/* let every cue of a sorted array stop where the next cue with a later
+ * timestamp starts, the last ones stay open. Stops are then monotonic as
+ * well, which gst_lrc_cues_find relies on. */
+static void
+gst_lrc_cues_set_stops (GArray * cues)
+{
+  GstLrcCue *cue;
+  GstClockTime stop = GST_CLOCK_TIME_NONE;
+  guint i;
+
+  cue = (GstLrcCue *) cues->data;
+  for (i = cues->len; i > 0; i--) {
+    if (i < cues->len && cue[i].start != cue[i - 1].start)
+      stop = cue[i].start;
+    cue[i - 1].stop = stop;
+  }
+}
+
+/* order the cues by timestamp and set their stops */
+void
+gst_lrc_cues_sort (GArray * cues)
+{
+  gst_lrc_cues_order (cues);
+  gst_lrc_cues_set_stops (cues);
+}
+
+/* index of the first cue still showing at time, n_cues if none */
+guint
+gst_lrc_cues_find (const GstLrcCue * cues, guint n_cues, GstClockTime time)
+{
+  guint lo = 0;
+  guint hi = n_cues;
+  guint mid;
+
+  while (lo < hi) {
+    mid = lo + (hi - lo) / 2;
+    if (cues[mid].stop <= time)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+
+  return lo;
+}
+
+/* Pack the sorted cues, the text block and the tags into one block, see
+ * GstLrcIndex. The block is the malloc data of the text buffer. */
+GstLrcIndex *
+gst_lrc_index_new (const GstLrcCue * cues, guint n_cues, const guint8 * text,
+    gsize len, gchar ** tags)
+{
+  GstLrcIndex *index;
+  gsize tag_len[GST_LRC_TAG_COUNT];
+  gsize cues_at, text_at, tags_at, size;
+  guint8 *block;
+  guint i;
+
+  cues_at = GST_ROUND_UP_8 (sizeof (GstLrcIndex));
+  text_at = cues_at + n_cues * sizeof (GstLrcCue);
+  tags_at = text_at + len;
+  size = tags_at;
+  for (i = 0; i < GST_LRC_TAG_COUNT; i++) {
+    tag_len[i] = tags && tags[i] ? strlen (tags[i]) + 1 : 0;
+    size += tag_len[i];
+  }
+
+  block = g_malloc (size);
+  index = (GstLrcIndex *) block;
+  index->refcount = 1;
+  index->n_cues = n_cues;
+  index->cues = (GstLrcCue *) (block + cues_at);
+  if (n_cues > 0)
+    memcpy (index->cues, cues, n_cues * sizeof (GstLrcCue));
+  if (len > 0)
+    memcpy (block + text_at, text, len);
+
+  for (i = 0; i < GST_LRC_TAG_COUNT; i++) {
+    index->tags[i] = NULL;
+    if (tag_len[i] > 0) {
+      index->tags[i] = (gchar *) block + tags_at;
+      memcpy (index->tags[i], tags[i], tag_len[i]);
+      tags_at += tag_len[i];
+    }
+  }
+
+  index->text = gst_buffer_new ();
+  GST_BUFFER_DATA (index->text) = block + text_at;
+  GST_BUFFER_SIZE (index->text) = len;
+  GST_BUFFER_MALLOCDATA (index->text) = block;
+  index->offset = 0;
+  index->size = size;
+  index->mapping = NULL;
+
+  return index;
+}
+
+GstLrcIndex *
+gst_lrc_index_ref (GstLrcIndex * index)
+{
+  g_atomic_int_inc (&index->refcount);
+  return index;
+}
+
+void
+gst_lrc_index_unref (GstLrcIndex * index)
+{
+  GstBuffer *mapping;
+
+  if (!g_atomic_int_dec_and_test (&index->refcount))
+    return;
+
+  /* a parsed index lives in the block of its text, the cues may still
+   * hold on to it */
+  mapping = index->mapping;
+  gst_buffer_unref (index->text);
+  if (mapping) {
+    gst_buffer_unref (mapping);
+    g_free (index);
+  }
+}
+
+/* memory held by the index, for cache accounting */
+gsize
+gst_lrc_index_get_size (const GstLrcIndex * index)
+{
+  return index->size;
+}
+
+/* the last timestamp of a file is its total time, it usually comes with
+ * an empty line that ends the last lyric */
+GstClockTime
+gst_lrc_index_get_duration (const GstLrcIndex * index)
+{
+  if (index->n_cues == 0)
+    return GST_CLOCK_TIME_NONE;
+
+  return index->cues[index->n_cues - 1].start;
+}
+
+/* the header tags as a GstTagList, NULL if there are none */
+GstTagList *
+gst_lrc_tags_to_tag_list (gchar ** tags)
+{
+  GstTagList *list;
+  guint64 version;
+  gchar *end;
+
+  list = gst_tag_list_new ();
+  if (tags[GST_LRC_TAG_TITLE])
+    gst_tag_list_add (list, GST_TAG_MERGE_REPLACE, GST_TAG_TITLE,
+        tags[GST_LRC_TAG_TITLE], NULL);
+  if (tags[GST_LRC_TAG_ARTIST])
+    gst_tag_list_add (list, GST_TAG_MERGE_REPLACE, GST_TAG_ARTIST,
+        tags[GST_LRC_TAG_ARTIST], NULL);
+  if (tags[GST_LRC_TAG_ALBUM])
+    gst_tag_list_add (list, GST_TAG_MERGE_REPLACE, GST_TAG_ALBUM,
+        tags[GST_LRC_TAG_ALBUM], NULL);
+  if (tags[GST_LRC_TAG_CREATOR])
+    gst_tag_list_add (list, GST_TAG_MERGE_REPLACE, GST_TAG_COMMENT,
+        tags[GST_LRC_TAG_CREATOR], NULL);
+  if (tags[GST_LRC_TAG_EDITOR])
+    gst_tag_list_add (list, GST_TAG_MERGE_REPLACE, GST_TAG_ENCODER,
+        tags[GST_LRC_TAG_EDITOR], NULL);
+  if (tags[GST_LRC_TAG_VERSION]) {
+    version = g_ascii_strtoull (tags[GST_LRC_TAG_VERSION], &end, 10);
+    if (end != tags[GST_LRC_TAG_VERSION] && version <= G_MAXUINT)
+      gst_tag_list_add (list, GST_TAG_MERGE_REPLACE, GST_TAG_ENCODER_VERSION,
+          (guint) version, NULL);
+  }
+
+  if (gst_tag_list_is_empty (list)) {
+    gst_tag_list_free (list);
+    return NULL;
+  }
+  return list;
+}
+
+void
+gst_lrc_parser_init (GstLrcParser * parser)
+{
+  parser->cues = g_array_new (FALSE, FALSE, sizeof (GstLrcCue));
+  parser->text = g_byte_array_new ();
+  gst_lrc_intern_table_init (&parser->intern);
+  memset (parser->tags, 0, sizeof (parser->tags));
+  parser->offset = 0;
+  parser->words = NULL;
+  parser->line = NULL;
+}
+
+void
+gst_lrc_parser_clear (GstLrcParser * parser)
+{
+  guint i;
+
+  g_array_free (parser->cues, TRUE);
+  g_byte_array_free (parser->text, TRUE);
+  gst_lrc_intern_table_clear (&parser->intern);
+  for (i = 0; i < GST_LRC_TAG_COUNT; i++)
+    g_free (parser->tags[i]);
+  if (parser->words)
+    g_array_free (parser->words, TRUE);
+  if (parser->line)
+    g_byte_array_free (parser->line, TRUE);
+}
+
+/* drop the cues parsed so far but keep the storage, tags stay */
+void
+gst_lrc_parser_reset (GstLrcParser * parser)
+{
+  g_array_set_size (parser->cues, 0);
+  g_byte_array_set_size (parser->text, 0);
+  gst_lrc_intern_table_reset (&parser->intern);
+}
+
+/* Forget the file, tags included. The storage is released too: after a
+ * whole file it is as big as the index that was packed from it, only
+ * reset() keeps it for the line by line reuse of push mode. */
+void
+gst_lrc_parser_rewind (GstLrcParser * parser)
+{
+  gst_lrc_parser_clear (parser);
+  gst_lrc_parser_init (parser);
+}
+
+const gchar *
+gst_lrc_tag_get_name (GstLrcTag tag)
+{
+  return tag < GST_LRC_TAG_COUNT ? lrc_tag_names[tag] : NULL;
+}
+
+/* Recognise a "[name:value]" header line with one switch on the tag name.
+ * Returns GST_LRC_TAG_COUNT for anything else, timestamps included, and
+ * sets value to the offset of the value in the line. */
+static GstLrcTag
+gst_lrc_match_tag (const gchar * line, gsize len, gsize * value)
+{
+  const gchar *colon;
+  gsize n;
+
+  if (len < 4 || line[0] != '[')
+    return GST_LRC_TAG_COUNT;
+
+  colon = memchr (line + 1, ':', MIN (len - 1, 7));
+  if (!colon)
+    return GST_LRC_TAG_COUNT;
+
+  n = colon - (line + 1);
+  *value = n + 2;
+
+  if (n == 6)
+    return memcmp (line + 1, "offset", 6) == 0 ?
+        GST_LRC_TAG_OFFSET : GST_LRC_TAG_COUNT;
+  if (n != 2)
+    return GST_LRC_TAG_COUNT;
+
+  switch (LRC_TAG_ID (line[1], line[2])) {
+    case LRC_TAG_ID ('t', 'i'):
+      return GST_LRC_TAG_TITLE;
+    case LRC_TAG_ID ('a', 'r'):
+      return GST_LRC_TAG_ARTIST;
+    case LRC_TAG_ID ('a', 'l'):
+      return GST_LRC_TAG_ALBUM;
+    case LRC_TAG_ID ('b', 'y'):
+      return GST_LRC_TAG_CREATOR;
+    case LRC_TAG_ID ('r', 'e'):
+      return GST_LRC_TAG_EDITOR;
+    case LRC_TAG_ID ('v', 'e'):
+      return GST_LRC_TAG_VERSION;
+    default:
+      return GST_LRC_TAG_COUNT;
+  }
+}
+
+static void
+gst_lrc_parser_set_tag (GstLrcParser * parser, GstLrcTag tag,
+    const gchar * value, gsize len)
+{
+  const gchar *close;
+
+  /* drop the closing bracket and surrounding blanks */
+  close = memchr (value, ']', len);
+  if (close)
+    len = close - value;
+  while (len > 0 && g_ascii_isspace (*value)) {
+    value++;
+    len--;
+  }
+  while (len > 0 && g_ascii_isspace (value[len - 1]))
+    len--;
+
+  g_free (parser->tags[tag]);
+  parser->tags[tag] = g_strndup (value, len);
+
+  if (tag == GST_LRC_TAG_OFFSET)
+    parser->offset = (gint) g_ascii_strtoll (parser->tags[tag], NULL, 10);
+
+  GST_DEBUG ("tag %s: %s", lrc_tag_names[tag], parser->tags[tag]);
+}
+
+/* at most 9 digits per field, so the sums below can not overflow */
+#define LRC_STAMP_MAX_DIGITS 9
+
+/* Decode one "[mm:ss]", "[mm:ss.xx]", "[mm:ss.xxx]" or "[hh:mm:ss.xx]"
+ * timestamp starting at p, or the same in angle brackets as used for the
+ * words of enhanced lrc. The fraction is scaled by its number of digits,
+ * digits beyond milliseconds are ignored. Returns the position after the
+ * closing bracket, or NULL if p does not start a timestamp. */
+static const gchar *
+gst_lrc_parse_timestamp (const gchar * p, const gchar * end,
+    GstClockTime * timestamp)
+{
+  guint64 fields[3];
+  guint n_fields = 0;
+  guint64 value, msec = 0, scale = 100;
+  guint digits;
+  gchar close;
+
+  if (p >= end || (*p != '[' && *p != '<'))
+    return NULL;
+  close = *p++ == '[' ? ']' : '>';
+
+  /* numeric fields separated by ':' */
+  for (;;) {
+    value = 0;
+    for (digits = 0; p < end && g_ascii_isdigit (*p); p++, digits++) {
+      if (digits == LRC_STAMP_MAX_DIGITS)
+        return NULL;
+      value = value * 10 + (*p - '0');
+    }
+    if (digits == 0)
+      return NULL;
+    fields[n_fields++] = value;
+
+    if (p < end && *p == ':' && n_fields < 3)
+      p++;
+    else
+      break;
+  }
+  if (n_fields < 2)
+    return NULL;
+
+  /* optional fraction */
+  if (p < end && *p == '.') {
+    p++;
+    for (digits = 0; p < end && g_ascii_isdigit (*p); p++, digits++) {
+      msec += (*p - '0') * scale;
+      scale /= 10;
+    }
+    if (digits == 0)
+      return NULL;
+  }
+
+  if (p >= end || *p != close)
+    return NULL;
+
+  if (n_fields == 3)
+    value = (fields[0] * 60 + fields[1]) * 60 + fields[2];
+  else
+    value = fields[0] * 60 + fields[1];
+  *timestamp = value * GST_SECOND + msec * GST_MSECOND;
+
+  return p + 1;
+}
+
+/* Tell header and timed lines from anything else, without parsing them.
+ * Used by the typefinder on the first bytes of a stream. */
+GstLrcLineKind
+gst_lrc_classify_line (const gchar * line, gsize len)
+{
+  GstClockTime time;
+  gsize value;
+
+  if (gst_lrc_parse_timestamp (line, line + len, &time))
+    return GST_LRC_LINE_TIMED;
+  if (gst_lrc_match_tag (line, len, &value) != GST_LRC_TAG_COUNT)
+    return GST_LRC_LINE_TAG;
+  return GST_LRC_LINE_OTHER;
+}
+
+/* Strip the "<mm:ss.xx>" word times out of an enhanced lrc lyric and pack
+ * the text with its word table into parser->line. Returns FALSE if the
+ * lyric has no word times after all. */
+static gboolean
+gst_lrc_parser_split_words (GstLrcParser * parser, const gchar * p,
+    const gchar * end, GstClockTime line_start)
+{
+  GByteArray *out;
+  GstLrcWord word;
+  GstLrcWord *words;
+  GstClockTime time;
+  const gchar *next, *run;
+  guint8 *rec;
+  guint i, n;
+  gboolean timed = FALSE;
+
+  if (!parser->words) {
+    parser->words = g_array_new (FALSE, FALSE, sizeof (GstLrcWord));
+    parser->line = g_byte_array_new ();
+  }
+  out = parser->line;
+  g_array_set_size (parser->words, 0);
+  g_byte_array_set_size (out, 0);
+
+  while (p < end) {
+    run = memchr (p, '<', end - p);
+    if (!run)
+      run = end;
+    if (run > p) {
+      /* text before the first time starts with the line */
+      if (parser->words->len == 0) {
+        word.start = 0;
+        word.offset = 0;
+        g_array_append_val (parser->words, word);
+      }
+      g_byte_array_append (out, (const guint8 *) p, run - p);
+      p = run;
+    }
+    if (p == end)
+      break;
+
+    next = gst_lrc_parse_timestamp (p, end, &time);
+    if (!next) {
+      /* not a time, a literal '<' */
+      if (parser->words->len == 0) {
+        word.start = 0;
+        word.offset = 0;
+        g_array_append_val (parser->words, word);
+      }
+      g_byte_array_append (out, (const guint8 *) p, 1);
+      p++;
+      continue;
+    }
+
+    word.start = time > line_start ? time - line_start : 0;
+    word.offset = out->len;
+    g_array_append_val (parser->words, word);
+    timed = TRUE;
+    p = next;
+  }
+
+  if (!timed)
+    return FALSE;
+
+  n = parser->words->len;
+  words = (GstLrcWord *) parser->words->data;
+  for (i = 0; i < n; i++)
+    words[i].length = (i + 1 < n ? words[i + 1].offset : out->len) -
+        words[i].offset;
+
+  /* text, NUL, count and records */
+  i = out->len;
+  g_byte_array_set_size (out, i + 1 + 4 + n * GST_LRC_WORD_RECORD_SIZE);
+  out->data[i] = '\0';
+  rec = out->data + i + 1;
+  GST_WRITE_UINT32_LE (rec, n);
+  rec += 4;
+  for (i = 0; i < n; i++, rec += GST_LRC_WORD_RECORD_SIZE) {
+    GST_WRITE_UINT64_LE (rec, words[i].start);
+    GST_WRITE_UINT32_LE (rec + 8, words[i].offset);
+    GST_WRITE_UINT32_LE (rec + 12, words[i].length);
+  }
+
+  return TRUE;
+}
+
+/* length of text cut to at most max bytes, without splitting a utf-8
+ * sequence */
+gsize
+gst_lrc_text_clamp (const gchar * text, gsize len, gsize max)
+{
+  if (len <= max)
+    return len;
+
+  len = max;
+  while (len > 0 && (text[len] & 0xc0) == 0x80)
+    len--;
+  return len;
+}
+
+/* number of word times behind the text of a cue, 0 for plain lrc */
+guint
+gst_lrc_words_count (const guint8 * data, gsize size)
+{
+  const guint8 *nul;
+  gsize table;
+  guint32 n;
+
+  nul = memchr (data, '\0', size);
+  if (!nul)
+    return 0;
+  table = nul + 1 - data;
+  if (table + 4 > size)
+    return 0;
+
+  n = GST_READ_UINT32_LE (data + table);
+  if ((guint64) n * GST_LRC_WORD_RECORD_SIZE > size - table - 4)
+    return 0;
+  return n;
+}
+
+gboolean
+gst_lrc_words_get (const guint8 * data, gsize size, guint n,
+    GstLrcWord * word)
+{
+  const guint8 *rec;
+
+  if (n >= gst_lrc_words_count (data, size))
+    return FALSE;
+
+  rec = (const guint8 *) memchr (data, '\0', size) + 1 + 4 +
+      n * GST_LRC_WORD_RECORD_SIZE;
+  word->start = GST_READ_UINT64_LE (rec);
+  word->offset = GST_READ_UINT32_LE (rec + 8);
+  word->length = GST_READ_UINT32_LE (rec + 12);
+  return TRUE;
+}
+
+/* Make the word times relative to a start later by shift, for a cue
+ * clipped to the segment. Words that began before it start at 0. */
+void
+gst_lrc_words_shift (guint8 * data, gsize size, GstClockTime shift)
+{
+  guint8 *rec;
+  guint64 start;
+  guint i, n;
+
+  n = gst_lrc_words_count (data, size);
+  if (n == 0)
+    return;
+
+  rec = (guint8 *) memchr (data, '\0', size) + 1 + 4;
+  for (i = 0; i < n; i++, rec += GST_LRC_WORD_RECORD_SIZE) {
+    start = GST_READ_UINT64_LE (rec);
+    GST_WRITE_UINT64_LE (rec, start > shift ? start - shift : 0);
+  }
+}
+
+/* Append a cue for each of the timestamps starting at *p and move *p
+ * behind them. FALSE if there are none. */
+static gboolean
+gst_lrc_parser_add_stamps (GstLrcParser * parser, const gchar ** p,
+    const gchar * end)
+{
+  GstClockTime timestamp;
+  GstLrcCue cue;
+  const gchar *next;
+  guint first = parser->cues->len;
+
+  while (*p < end && **p == '[' &&
+      (next = gst_lrc_parse_timestamp (*p, end, &timestamp))) {
+    GST_LOG ("timestamp %" GST_TIME_FORMAT, GST_TIME_ARGS (timestamp));
+    cue.start = timestamp;
+    cue.stop = GST_CLOCK_TIME_NONE;
+    cue.offset = 0;
+    cue.length = 0;
+    g_array_append_val (parser->cues, cue);
+    *p = next;
+  }
+
+  return parser->cues->len > first;
+}
+
+/* parse string, if valid, store data*/
+gboolean
+gst_lrc_parse_line(GstLrcParser *parser, const gchar* line, gsize len)
+{
+  GST_DEBUG("line str: %.*s", (gint) len, line);
+  if ( len > 0 && line[0] == '[' )
+  {
+    GstLrcTag tag;
+    gsize value;
+
+    tag = gst_lrc_match_tag(line, len, &value);
+    if (tag != GST_LRC_TAG_COUNT) {
+      gst_lrc_parser_set_tag(parser, tag, line + value, len - value);
+    }
+    else {
+      const gchar *p = line;
+      const gchar *end = line + len;
+      const gchar *text;
+      gsize textlen;
+      guint first = parser->cues->len;
+      guint32 offset;
+      guint i;
+
+      /* [mm:ss.xx][mm:ss.xx]...lyric, all timestamps share the text */
+      if (!gst_lrc_parser_add_stamps(parser, &p, end))
+      {
+        GST_DEBUG("no timestamp in line");
+        return FALSE;
+      }
+
+      /* enhanced lrc, the word times are relative to the first stamp */
+      text = p;
+      textlen = end - p;
+      if (memchr(p, '<', end - p) && gst_lrc_parser_split_words(parser, p,
+              end, g_array_index(parser->cues, GstLrcCue, first).start))
+      {
+        text = (const gchar *) parser->line->data;
+        textlen = parser->line->len;
+      }
+
+      /* identical lines, think chorus, are stored only once */
+      offset = gst_lrc_intern_table_add(&parser->intern, parser->text, text, textlen);
+      for (i = first; i < parser->cues->len; i++)
+      {
+        g_array_index(parser->cues, GstLrcCue, i).offset = offset;
+        g_array_index(parser->cues, GstLrcCue, i).length = textlen;
+      }
+      GST_DEBUG("append %u", parser->cues->len - first);
+      return TRUE;
+    }
+  }
+  else
+    GST_DEBUG("Invalid format, not support");
+  
+  return FALSE;
+}
+
+/* Index a line without keeping its text, for files too large to hold.
+ * The cues of a lyric point at the whole line, which starts at pos in the
+ * source, or have length 0 when nothing follows the timestamps. Tags are
+ * kept as usual. */
+gboolean
+gst_lrc_parse_line_ref (GstLrcParser * parser, const gchar * line, gsize len,
+    guint64 pos)
+{
+  const gchar *p = line;
+  const gchar *end = line + len;
+  GstLrcCue *cue;
+  GstLrcTag tag;
+  gsize value;
+  guint first, i;
+
+  if (len == 0 || line[0] != '[')
+    return FALSE;
+
+  tag = gst_lrc_match_tag (line, len, &value);
+  if (tag != GST_LRC_TAG_COUNT) {
+    gst_lrc_parser_set_tag (parser, tag, line + value, len - value);
+    return FALSE;
+  }
+
+  if (pos + len > G_MAXUINT32) {
+    GST_DEBUG ("line at %" G_GUINT64_FORMAT " is out of reach", pos);
+    return FALSE;
+  }
+
+  first = parser->cues->len;
+  if (!gst_lrc_parser_add_stamps (parser, &p, end))
+    return FALSE;
+
+  for (i = first; i < parser->cues->len; i++) {
+    cue = &g_array_index (parser->cues, GstLrcCue, i);
+    cue->offset = pos;
+    cue->length = p < end ? len : 0;
+  }
+  return TRUE;
+}
+
+/* The text gst_lrc_parse_line would have stored for a line read back
+ * after gst_lrc_parse_line_ref. Points into line or into the parser and
+ * is valid until the next call. */
+const gchar *
+gst_lrc_parser_line_text (GstLrcParser * parser, const gchar * line,
+    gsize len, gsize * textlen)
+{
+  const gchar *p = line;
+  const gchar *end = line + len;
+  const gchar *next;
+  GstClockTime timestamp, first = GST_CLOCK_TIME_NONE;
+
+  while (p < end && *p == '[' &&
+      (next = gst_lrc_parse_timestamp (p, end, &timestamp))) {
+    if (!GST_CLOCK_TIME_IS_VALID (first))
+      first = timestamp;
+    p = next;
+  }
+
+  if (GST_CLOCK_TIME_IS_VALID (first) && memchr (p, '<', end - p) &&
+      gst_lrc_parser_split_words (parser, p, end, first)) {
+    *textlen = parser->line->len;
+    return (const gchar *) parser->line->data;
+  }
+
+  *textlen = end - p;
+  return p;
+}
+
+/* parse a complete file held in memory */
+void
+gst_lrc_parser_parse (GstLrcParser * parser, const gchar * data, gsize size)
+{
+  GstLrcLineScanner scanner;
+  const gchar *line;
+  gsize linelen;
+
+  gst_lrc_line_scanner_init (&scanner);
+  gst_lrc_line_scanner_feed (&scanner, data, size);
+  while (gst_lrc_line_scanner_next (&scanner, &line, &linelen))
+    gst_lrc_parse_line (parser, line, linelen);
+  if (gst_lrc_line_scanner_finish (&scanner, &line, &linelen))
+    gst_lrc_parse_line (parser, line, linelen);
+  gst_lrc_line_scanner_clear (&scanner);
+}
+
+/* apply an [offset:] in milliseconds to a timestamp, a positive offset
+ * makes the lyrics show up earlier */
+GstClockTime
+gst_lrc_cue_shift (GstClockTime time, gint offset_ms)
+{
+  GstClockTime shift;
+
+  if (offset_ms < 0)
+    return time + (GstClockTime) (-(gint64) offset_ms) * GST_MSECOND;
+
+  shift = (GstClockTime) offset_ms * GST_MSECOND;
+  return time > shift ? time - shift : 0;
+}
+
+static void
+gst_lrc_parser_shift_cues (GstLrcParser * parser)
+{
+  GstLrcCue *cue;
+  guint i;
+
+  if (parser->offset == 0)
+    return;
+
+  for (i = 0; i < parser->cues->len; i++) {
+    cue = &g_array_index (parser->cues, GstLrcCue, i);
+    cue->start = gst_lrc_cue_shift (cue->start, parser->offset);
+  }
+}
+
+/* hand the sorted cues over to a new index and rewind */
+static GstLrcIndex *
+gst_lrc_parser_pack (GstLrcParser * parser)
+{
+  GstLrcIndex *index;
+
+  /* not needed for packing, let it go before the block is allocated */
+  gst_lrc_intern_table_clear (&parser->intern);
+
+  index = gst_lrc_index_new ((const GstLrcCue *) parser->cues->data,
+      parser->cues->len, parser->text->data, parser->text->len, parser->tags);
+  index->offset = parser->offset;
+
+  gst_lrc_parser_rewind (parser);
+
+  return index;
+}
+
+/* sort what was parsed and hand it over to a new index, the parser is
+ * empty and ready for the next file afterwards */
+GstLrcIndex *
+gst_lrc_parser_finish (GstLrcParser * parser)
+{
+  gst_lrc_parser_shift_cues (parser);
+  gst_lrc_cues_sort (parser->cues);
+
+  return gst_lrc_parser_pack (parser);
+}
+
+/* Set up the library for use without the plugin, after gst_init (). */
+void
+gst_lrc_init (void)
+{
+  if (!lrcparse_debug)
+    GST_DEBUG_CATEGORY_INIT (lrcparse_debug, "lrcparse", 0, "lrc parser");
+}
+
+/* a joinable thread, NULL if it could not be created; g_thread_create is
+ * deprecated from GLib 2.32 on, which is also where its successor came */
+GThread *
+gst_lrc_thread_new (const gchar * name, GThreadFunc func, gpointer data)
+{
+#if GLIB_CHECK_VERSION (2, 32, 0)
+  return g_thread_try_new (name, func, data, NULL);
+#else
+  return g_thread_create (func, data, TRUE, NULL);
+#endif
+}
+
+static void
+gst_lrc_mapped_file_free (GMappedFile * mapped)
+{
+#if GLIB_CHECK_VERSION (2, 22, 0)
+  g_mapped_file_unref (mapped);
+#else
+  g_mapped_file_free (mapped);
+#endif
+}
+
+/* The contents of the file at path as a read-only buffer that keeps the
+ * mapping, NULL with error set if it could not be mapped. */
+GstBuffer *
+gst_lrc_buffer_new_mapped (const gchar * path, GError ** error)
+{
+  GstBuffer *buf;
+  GMappedFile *mapped;
+
+  mapped = g_mapped_file_new (path, FALSE, error);
+  if (!mapped)
+    return NULL;
+
+  buf = gst_buffer_new ();
+  GST_BUFFER_DATA (buf) = (guint8 *) g_mapped_file_get_contents (mapped);
+  GST_BUFFER_SIZE (buf) = g_mapped_file_get_length (mapped);
+  GST_BUFFER_MALLOCDATA (buf) = (guint8 *) mapped;
+  GST_BUFFER_FREE_FUNC (buf) = (GFreeFunc) gst_lrc_mapped_file_free;
+
+  return buf;
+}
+
+guint
+gst_lrc_n_processors (void)
+{
+  glong n;
+
+  n = sysconf (_SC_NPROCESSORS_ONLN);
+  return n > 0 ? n : 1;
+}
+
+/* texts smaller than two chunks are parsed on the calling thread */
+#define LRC_PARSE_CHUNK_MIN (256 * 1024)
+
+typedef struct _GstLrcParseChunk {
+  GstLrcParser   parser;
+  const gchar   *data;
+  gsize          size;
+  GThread       *thread;
+} GstLrcParseChunk;
+
+static gpointer
+gst_lrc_parse_chunk (gpointer data)
+{
+  GstLrcParseChunk *chunk = data;
+
+  gst_lrc_parser_parse (&chunk->parser, chunk->data, chunk->size);
+  gst_lrc_cues_order (chunk->parser.cues);
+
+  return NULL;
+}
+
+/* Merge the sorted runs of the chunks into the cues of parser, joining
+ * their text blocks. Tags found in a later chunk win, as they would when
+ * parsing line by line. */
+static void
+gst_lrc_parser_merge_chunks (GstLrcParser * parser, GstLrcParseChunk * chunks,
+    guint n_chunks)
+{
+  GstLrcParser *run;
+  GstLrcCue *cue;
+  guint *pos;
+  guint32 base;
+  guint i, j, n, best;
+
+  n = 0;
+  for (i = 0; i < n_chunks; i++) {
+    run = &chunks[i].parser;
+    for (j = 0; j < GST_LRC_TAG_COUNT; j++) {
+      if (!run->tags[j])
+        continue;
+      g_free (parser->tags[j]);
+      parser->tags[j] = run->tags[j];
+      run->tags[j] = NULL;
+      if (j == GST_LRC_TAG_OFFSET)
+        parser->offset = run->offset;
+    }
+
+    /* the cues of a run point into its own text block and know their
+     * position in the chunk only */
+    base = parser->text->len;
+    g_byte_array_append (parser->text, run->text->data, run->text->len);
+    cue = (GstLrcCue *) run->cues->data;
+    for (j = 0; j < run->cues->len; j++) {
+      cue[j].offset += base;
+      cue[j].stop += n;
+    }
+    n += run->cues->len;
+  }
+
+  /* there are only as many runs as threads, a scan over the heads is
+   * cheaper than a heap. Ties go to the earlier chunk. */
+  pos = g_new0 (guint, n_chunks);
+  g_array_set_size (parser->cues, n);
+  cue = (GstLrcCue *) parser->cues->data;
+  for (i = 0; i < n; i++) {
+    best = n_chunks;
+    for (j = 0; j < n_chunks; j++) {
+      run = &chunks[j].parser;
+      if (pos[j] == run->cues->len)
+        continue;
+      if (best == n_chunks ||
+          g_array_index (run->cues, GstLrcCue, pos[j]).start <
+          g_array_index (chunks[best].parser.cues, GstLrcCue,
+              pos[best]).start)
+        best = j;
+    }
+    cue[i] = g_array_index (chunks[best].parser.cues, GstLrcCue, pos[best]);
+    pos[best]++;
+  }
+  g_free (pos);
+}
+
+/* Parse a complete file held in memory on up to n_threads threads, 0 for
+ * one per processor, and finish it. The text is cut at line ends into one
+ * chunk per thread, each chunk is parsed into a sorted run and the runs
+ * are merged. Identical lines are only shared within a chunk. The parser
+ * must not hold cues yet. */
+GstLrcIndex *
+gst_lrc_parser_parse_parallel (GstLrcParser * parser, const gchar * data,
+    gsize size, guint n_threads)
+{
+  GstLrcParseChunk *chunks;
+  GstLrcCue *cue;
+  const gchar *p, *end, *lf;
+  gsize share;
+  guint n, i;
+
+  if (n_threads == 0)
+    n_threads = gst_lrc_n_processors ();
+  n = MIN (n_threads, size / LRC_PARSE_CHUNK_MIN);
+  if (n < 2) {
+    gst_lrc_parser_parse (parser, data, size);
+    return gst_lrc_parser_finish (parser);
+  }
+
+  /* cut after the first '\n' past an even share, text with bare '\r'
+   * line ends stays in one piece */
+  chunks = g_new0 (GstLrcParseChunk, n);
+  share = size / n;
+  p = data;
+  end = data + size;
+  for (i = 0; i < n && p < end; i++) {
+    gst_lrc_parser_init (&chunks[i].parser);
+    chunks[i].data = p;
+    lf = NULL;
+    if (i + 1 < n && (gsize) (end - p) > share)
+      lf = memchr (p + share, '\n', end - p - share);
+    p = lf ? lf + 1 : end;
+    chunks[i].size = p - chunks[i].data;
+  }
+  n = i;
+
+  for (i = 1; i < n; i++) {
+    chunks[i].thread = gst_lrc_thread_new ("lrcparse", gst_lrc_parse_chunk,
+        &chunks[i]);
+    if (!chunks[i].thread)
+      gst_lrc_parse_chunk (&chunks[i]);
+  }
+  gst_lrc_parse_chunk (&chunks[0]);
+  for (i = 1; i < n; i++) {
+    if (chunks[i].thread)
+      g_thread_join (chunks[i].thread);
+  }
+
+  gst_lrc_parser_merge_chunks (parser, chunks, n);
+  for (i = 0; i < n; i++)
+    gst_lrc_parser_clear (&chunks[i].parser);
+  g_free (chunks);
+
+  GST_DEBUG ("%u cues from %u chunks", parser->cues->len, n);
+
+  /* shifting keeps the order, except that the cues an offset moves
+   * before zero all end up at zero and go back to file order */
+  gst_lrc_parser_shift_cues (parser);
+  cue = (GstLrcCue *) parser->cues->data;
+  for (i = 0; i < parser->cues->len && cue[i].start == 0; i++);
+  if (i > 1)
+    qsort (cue, i, sizeof (GstLrcCue), gst_lrc_cue_compare);
+  gst_lrc_cues_set_stops (parser->cues);
+
+  return gst_lrc_parser_pack (parser);
+}
@@ -0,0 +1,219 @@
+/* GStreamer
+ * Copyright (C) <2008> Zhao Liang <zlweb@163.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifndef __GST_LRC_PARSE_H__
+#define __GST_LRC_PARSE_H__
+
+#include <gst/gst.h>
+
+G_BEGIN_DECLS
+
+/* media type of lrc text, the binary index has LRC_BINARY_CAPS */
+#define LRC_CAPS                "application/x-lrc"
+
+/* One timed lyric line. The text lives in a separate text block, the cue
+ * only records where; stop is the start of the next cue. Cues indexed
+ * with gst_lrc_parse_line_ref locate their whole line in the source
+ * instead. */
+typedef struct _GstLrcCue {
+  GstClockTime   start;
+  GstClockTime   stop;
+  guint32        offset;
+  guint32        length;
+} GstLrcCue;
+
+/* One word of an enhanced lrc line, "<mm:ss.xx>word". start is relative
+ * to the timestamp of the buffer carrying the cue, offset and length
+ * locate the word in the text of the cue. */
+typedef struct _GstLrcWord {
+  GstClockTime   start;
+  guint32        offset;
+  guint32        length;
+} GstLrcWord;
+
+/* Enhanced lrc cues carry the times of their words behind the terminating
+ * NUL of their text: a little endian guint32 count followed by one record
+ * per word with the fields of GstLrcWord. Plain cues end at the NUL. */
+#define GST_LRC_WORD_RECORD_SIZE 16
+
+/* Kinds of lrc lines, as told apart by gst_lrc_classify_line() */
+typedef enum {
+  GST_LRC_LINE_OTHER,
+  GST_LRC_LINE_TAG,             /* known header tag */
+  GST_LRC_LINE_TIMED            /* starts with a [mm:ss.xx] timestamp */
+} GstLrcLineKind;
+
+/* Metadata tags of the lrc header */
+typedef enum {
+  GST_LRC_TAG_TITLE,            /* [ti:] */
+  GST_LRC_TAG_ARTIST,           /* [ar:] */
+  GST_LRC_TAG_ALBUM,            /* [al:] */
+  GST_LRC_TAG_CREATOR,          /* [by:] */
+  GST_LRC_TAG_EDITOR,           /* [re:] */
+  GST_LRC_TAG_VERSION,          /* [ve:] */
+  GST_LRC_TAG_OFFSET,           /* [offset:] */
+  GST_LRC_TAG_COUNT
+} GstLrcTag;
+
+/* The immutable result of parsing one file: the sorted cues and the text
+ * block they point into. It is refcounted so that elements and caches can
+ * share it, the pushed cues are sub-buffers of text.
+ *
+ * A parsed index is one allocation: the struct, the cues, the text and
+ * the tag values, owned by the text buffer. It goes away in one free once
+ * the index and the last pushed cue are gone. A binary index points into
+ * its mapping instead. */
+typedef struct _GstLrcIndex {
+  volatile gint  refcount;
+
+  GstLrcCue     *cues;
+  guint          n_cues;
+  GstBuffer     *text;
+
+  /* tag values, NULL when absent; the offset is already applied to cues */
+  gchar         *tags[GST_LRC_TAG_COUNT];
+  gint           offset;
+
+  /* memory held, for cache accounting */
+  gsize          size;
+
+  /* the binary index the cues and tags point into, if any */
+  GstBuffer     *mapping;
+} GstLrcIndex;
+
+/* Splits lrc text into lines without copying them. Lines are handed out
+ * as (pointer, length) views into the fed data; only a line that straddles
+ * two fed chunks is assembled in the carry buffer. "\n", "\r\n" and a bare
+ * "\r" all end a line. */
+typedef struct _GstLrcLineScanner {
+  const gchar   *data;
+  gsize          size;
+  gsize          pos;
+
+  /* where data and the last line handed out start in all that was fed */
+  guint64        base;
+  guint64        offset;
+
+  /* offset of the next '\n' at or after pos, size if there is none */
+  gsize          lf;
+
+  GByteArray    *carry;
+  gboolean       carry_used;
+  gboolean       skip_lf;
+} GstLrcLineScanner;
+
+/* Open addressing set of the strings in a text block, used to store each
+ * distinct lyric line once. Slots hold offset + 1 so zero means empty. */
+typedef struct _GstLrcInternSlot {
+  guint32        hash;
+  guint32        offset;
+} GstLrcInternSlot;
+
+typedef struct _GstLrcInternTable {
+  GstLrcInternSlot *slots;
+  guint          size;
+  guint          used;
+} GstLrcInternTable;
+
+/* Collects cues and interned text line by line */
+typedef struct _GstLrcParser {
+  GArray        *cues;
+  GByteArray    *text;
+  GstLrcInternTable intern;
+
+  gchar         *tags[GST_LRC_TAG_COUNT];
+  gint           offset;
+
+  /* scratch space for enhanced lines, allocated on first use */
+  GArray        *words;
+  GByteArray    *line;
+} GstLrcParser;
+
+GST_DEBUG_CATEGORY_EXTERN (lrcparse_debug);
+
+void            gst_lrc_init                (void);
+GThread *       gst_lrc_thread_new          (const gchar * name,
+                                             GThreadFunc func, gpointer data);
+GstBuffer *     gst_lrc_buffer_new_mapped   (const gchar * path,
+                                             GError ** error);
+
+void            gst_lrc_line_scanner_init   (GstLrcLineScanner * scanner);
+void            gst_lrc_line_scanner_clear  (GstLrcLineScanner * scanner);
+void            gst_lrc_line_scanner_feed   (GstLrcLineScanner * scanner,
+                                             const gchar * data, gsize size);
+gboolean        gst_lrc_line_scanner_next   (GstLrcLineScanner * scanner,
+                                             const gchar ** line, gsize * len);
+gboolean        gst_lrc_line_scanner_finish (GstLrcLineScanner * scanner,
+                                             const gchar ** line, gsize * len);
+
+void            gst_lrc_intern_table_init   (GstLrcInternTable * table);
+void            gst_lrc_intern_table_reset  (GstLrcInternTable * table);
+void            gst_lrc_intern_table_clear  (GstLrcInternTable * table);
+guint32         gst_lrc_intern_table_add    (GstLrcInternTable * table,
+                                             GByteArray * text,
+                                             const gchar * str, gsize len);
+
+void            gst_lrc_cues_sort           (GArray * cues);
+GstClockTime    gst_lrc_cue_shift           (GstClockTime time, gint offset_ms);
+guint           gst_lrc_cues_find           (const GstLrcCue * cues,
+                                             guint n_cues, GstClockTime time);
+
+void            gst_lrc_parser_init         (GstLrcParser * parser);
+void            gst_lrc_parser_clear        (GstLrcParser * parser);
+void            gst_lrc_parser_reset        (GstLrcParser * parser);
+void            gst_lrc_parser_rewind       (GstLrcParser * parser);
+gboolean        gst_lrc_parse_line          (GstLrcParser * parser,
+                                             const gchar * line, gsize len);
+gboolean        gst_lrc_parse_line_ref      (GstLrcParser * parser,
+                                             const gchar * line, gsize len,
+                                             guint64 pos);
+const gchar *   gst_lrc_parser_line_text    (GstLrcParser * parser,
+                                             const gchar * line, gsize len,
+                                             gsize * textlen);
+void            gst_lrc_parser_parse        (GstLrcParser * parser,
+                                             const gchar * data, gsize size);
+GstLrcIndex *   gst_lrc_parser_finish       (GstLrcParser * parser);
+GstLrcIndex *   gst_lrc_parser_parse_parallel (GstLrcParser * parser,
+                                             const gchar * data, gsize size,
+                                             guint n_threads);
+guint           gst_lrc_n_processors        (void);
+GstLrcLineKind  gst_lrc_classify_line       (const gchar * line, gsize len);
+
+gsize           gst_lrc_text_clamp          (const gchar * text, gsize len,
+                                             gsize max);
+guint           gst_lrc_words_count         (const guint8 * data, gsize size);
+gboolean        gst_lrc_words_get           (const guint8 * data, gsize size,
+                                             guint n, GstLrcWord * word);
+void            gst_lrc_words_shift         (guint8 * data, gsize size,
+                                             GstClockTime shift);
+
+const gchar *   gst_lrc_tag_get_name        (GstLrcTag tag);
+GstTagList *    gst_lrc_tags_to_tag_list    (gchar ** tags);
+
+GstLrcIndex *   gst_lrc_index_new           (const GstLrcCue * cues,
+                                             guint n_cues, const guint8 * text,
+                                             gsize len, gchar ** tags);
+GstLrcIndex *   gst_lrc_index_ref           (GstLrcIndex * index);
+void            gst_lrc_index_unref         (GstLrcIndex * index);
+gsize           gst_lrc_index_get_size      (const GstLrcIndex * index);
+GstClockTime    gst_lrc_index_get_duration  (const GstLrcIndex * index);
+
+G_END_DECLS
+
+#endif /* __GST_LRC_PARSE_H__ */
@@ -0,0 +1,540 @@
+/* GStreamer
+ * Copyright (C) <2008> Zhao Liang <zlweb@163.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <string.h>
+#include "gstlrcsearch.h"
+#include "gstlrcbinary.h"
+
+#define GST_CAT_DEFAULT lrcparse_debug
+
+#define LRC_SEARCH_HEADER_CHECKSUM_OFFSET 28
+#define LRC_SEARCH_TERM_SIZE    12
+#define LRC_SEARCH_POSTING_SIZE 16
+
+struct _GstLrcSearch {
+  GPtrArray     *names;
+
+  /* folded word -> GArray of GstLrcSearchHit, in file and cue order */
+  GHashTable    *terms;
+  guint          n_postings;
+};
+
+typedef void (*GstLrcSearchTokenFunc) (gchar * token, gpointer data);
+
+typedef struct _GstLrcSearchQuery {
+  GstLrcSearch  *search;
+  GPtrArray     *lists;
+  gboolean       missing;
+} GstLrcSearchQuery;
+
+static void
+gst_lrc_search_emit (const gchar * word, const gchar * end,
+    GstLrcSearchTokenFunc func, gpointer data)
+{
+  gchar *folded, *token;
+
+  folded = g_utf8_casefold (word, end - word);
+  token = g_utf8_normalize (folded, -1, G_NORMALIZE_ALL_COMPOSE);
+  g_free (folded);
+
+  if (token)
+    func (token, data);
+}
+
+/* Split text into words: runs of letters, digits and the marks that go
+ * with them, and every wide letter on its own since CJK lyrics do not
+ * separate words. Words are case folded and normalized (NFKC) so that
+ * case and the way an accent is composed do not matter. func owns the
+ * word it is given. */
+static void
+gst_lrc_search_tokenize (const gchar * text, gsize len,
+    GstLrcSearchTokenFunc func, gpointer data)
+{
+  const gchar *p = text;
+  const gchar *end = text + len;
+  const gchar *word = NULL;
+  const gchar *next;
+  gunichar c;
+
+  while (p < end) {
+    c = g_utf8_get_char_validated (p, end - p);
+    if (c == (gunichar) - 1 || c == (gunichar) - 2) {
+      c = 0;
+      next = p + 1;
+    } else {
+      next = g_utf8_next_char (p);
+    }
+
+    if (g_unichar_isalnum (c) && g_unichar_iswide (c)) {
+      if (word)
+        gst_lrc_search_emit (word, p, func, data);
+      word = NULL;
+      gst_lrc_search_emit (p, next, func, data);
+    } else if (g_unichar_isalnum (c) || (word && g_unichar_ismark (c))) {
+      if (!word)
+        word = p;
+    } else if (word) {
+      gst_lrc_search_emit (word, p, func, data);
+      word = NULL;
+    }
+    p = next;
+  }
+
+  if (word)
+    gst_lrc_search_emit (word, end, func, data);
+}
+
+static void
+gst_lrc_search_free_postings (gpointer postings)
+{
+  g_array_free ((GArray *) postings, TRUE);
+}
+
+GstLrcSearch *
+gst_lrc_search_new (void)
+{
+  GstLrcSearch *search;
+
+  search = g_slice_new (GstLrcSearch);
+  search->names = g_ptr_array_new ();
+  search->terms = g_hash_table_new_full (g_str_hash, g_str_equal, g_free,
+      gst_lrc_search_free_postings);
+  search->n_postings = 0;
+
+  return search;
+}
+
+void
+gst_lrc_search_free (GstLrcSearch * search)
+{
+  guint i;
+
+  for (i = 0; i < search->names->len; i++)
+    g_free (g_ptr_array_index (search->names, i));
+  g_ptr_array_free (search->names, TRUE);
+  g_hash_table_destroy (search->terms);
+  g_slice_free (GstLrcSearch, search);
+}
+
+static GArray *
+gst_lrc_search_get_postings (GstLrcSearch * search, gchar * token)
+{
+  GArray *postings;
+
+  postings = g_hash_table_lookup (search->terms, token);
+  if (postings) {
+    g_free (token);
+    return postings;
+  }
+
+  postings = g_array_new (FALSE, FALSE, sizeof (GstLrcSearchHit));
+  g_hash_table_insert (search->terms, token, postings);
+  return postings;
+}
+
+typedef struct _GstLrcSearchAdd {
+  GstLrcSearch  *search;
+  GstLrcSearchHit hit;
+} GstLrcSearchAdd;
+
+static void
+gst_lrc_search_add_token (gchar * token, gpointer data)
+{
+  GstLrcSearchAdd *add = data;
+  GArray *postings;
+  GstLrcSearchHit *last;
+
+  postings = gst_lrc_search_get_postings (add->search, token);
+
+  /* a word repeated in a line is listed once */
+  if (postings->len > 0) {
+    last = &g_array_index (postings, GstLrcSearchHit, postings->len - 1);
+    if (last->file == add->hit.file && last->cue == add->hit.cue)
+      return;
+  }
+  g_array_append_val (postings, add->hit);
+  add->search->n_postings++;
+}
+
+/* Add the words of a parsed file, returns its number. A lazily indexed
+ * file holds no text and adds no words. */
+guint
+gst_lrc_search_add (GstLrcSearch * search, const gchar * name,
+    const GstLrcIndex * index)
+{
+  GstLrcSearchAdd add;
+  const GstLrcCue *cue;
+  const gchar *text, *nul;
+  gsize size, len;
+  guint i;
+
+  add.search = search;
+  add.hit.file = search->names->len;
+  g_ptr_array_add (search->names, g_strdup (name ? name : ""));
+
+  text = (const gchar *) GST_BUFFER_DATA (index->text);
+  size = GST_BUFFER_SIZE (index->text);
+
+  for (i = 0; i < index->n_cues; i++) {
+    cue = &index->cues[i];
+    if (cue->length == 0 || (guint64) cue->offset + cue->length > size)
+      continue;
+
+    /* enhanced lrc keeps the word times behind the text */
+    nul = memchr (text + cue->offset, '\0', cue->length);
+    len = nul ? nul - (text + cue->offset) : cue->length;
+
+    add.hit.cue = i;
+    add.hit.time = cue->start;
+    gst_lrc_search_tokenize (text + cue->offset, len,
+        gst_lrc_search_add_token, &add);
+  }
+
+  GST_DEBUG ("%s: file %u, %u words", GST_STR_NULL (name), add.hit.file,
+      g_hash_table_size (search->terms));
+  return add.hit.file;
+}
+
+guint
+gst_lrc_search_get_n_files (GstLrcSearch * search)
+{
+  return search->names->len;
+}
+
+const gchar *
+gst_lrc_search_get_name (GstLrcSearch * search, guint file)
+{
+  if (file >= search->names->len)
+    return NULL;
+  return g_ptr_array_index (search->names, file);
+}
+
+/* index of the first posting at or after the cue */
+static guint
+gst_lrc_search_lower_bound (GArray * postings, guint32 file, guint32 cue)
+{
+  const GstLrcSearchHit *hit;
+  guint lo = 0;
+  guint hi = postings->len;
+  guint mid;
+
+  while (lo < hi) {
+    mid = lo + (hi - lo) / 2;
+    hit = &g_array_index (postings, GstLrcSearchHit, mid);
+    if (hit->file < file || (hit->file == file && hit->cue < cue))
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+
+  return lo;
+}
+
+static gboolean
+gst_lrc_search_contains (GArray * postings, const GstLrcSearchHit * hit)
+{
+  const GstLrcSearchHit *found;
+  guint i;
+
+  i = gst_lrc_search_lower_bound (postings, hit->file, hit->cue);
+  if (i == postings->len)
+    return FALSE;
+  found = &g_array_index (postings, GstLrcSearchHit, i);
+  return found->file == hit->file && found->cue == hit->cue;
+}
+
+static void
+gst_lrc_search_query_token (gchar * token, gpointer data)
+{
+  GstLrcSearchQuery *query = data;
+  GArray *postings;
+  guint i;
+
+  postings = g_hash_table_lookup (query->search->terms, token);
+  g_free (token);
+
+  if (!postings) {
+    query->missing = TRUE;
+    return;
+  }
+  for (i = 0; i < query->lists->len; i++) {
+    if (g_ptr_array_index (query->lists, i) == postings)
+      return;
+  }
+  g_ptr_array_add (query->lists, postings);
+}
+
+static gint
+gst_lrc_search_compare_lists (gconstpointer a, gconstpointer b)
+{
+  const GArray *la = *(const GArray **) a;
+  const GArray *lb = *(const GArray **) b;
+
+  if (la->len != lb->len)
+    return la->len < lb->len ? -1 : 1;
+  return 0;
+}
+
+/* Cues containing all words of text, in file and cue order. file limits
+ * the search to one file, -1 searches all of them. Free the result with
+ * g_array_free. */
+GArray *
+gst_lrc_search_query (GstLrcSearch * search, const gchar * text, gint file)
+{
+  GstLrcSearchQuery query;
+  GArray *hits, *shortest;
+  const GstLrcSearchHit *hit;
+  guint i, j, lo, hi;
+
+  hits = g_array_new (FALSE, FALSE, sizeof (GstLrcSearchHit));
+
+  query.search = search;
+  query.lists = g_ptr_array_new ();
+  query.missing = FALSE;
+  gst_lrc_search_tokenize (text, strlen (text), gst_lrc_search_query_token,
+      &query);
+  if (query.missing || query.lists->len == 0)
+    goto done;
+
+  /* walk the rarest word and look the others up */
+  g_ptr_array_sort (query.lists, gst_lrc_search_compare_lists);
+  shortest = g_ptr_array_index (query.lists, 0);
+  lo = 0;
+  hi = shortest->len;
+  if (file >= 0) {
+    lo = gst_lrc_search_lower_bound (shortest, file, 0);
+    hi = gst_lrc_search_lower_bound (shortest, file + 1, 0);
+  }
+
+  for (i = lo; i < hi; i++) {
+    hit = &g_array_index (shortest, GstLrcSearchHit, i);
+    for (j = 1; j < query.lists->len; j++) {
+      if (!gst_lrc_search_contains (g_ptr_array_index (query.lists, j), hit))
+        break;
+    }
+    if (j == query.lists->len)
+      g_array_append_vals (hits, hit, 1);
+  }
+
+done:
+  GST_LOG ("\"%s\": %u hits", text, hits->len);
+  g_ptr_array_free (query.lists, TRUE);
+  return hits;
+}
+
+/* a flushing seek of lrcdemux, or the pipeline, to the cue of hit */
+GstEvent *
+gst_lrc_search_hit_seek (const GstLrcSearchHit * hit)
+{
+  return gst_event_new_seek (1.0, GST_FORMAT_TIME, GST_SEEK_FLAG_FLUSH,
+      GST_SEEK_TYPE_SET, hit->time, GST_SEEK_TYPE_NONE, -1);
+}
+
+static gint
+gst_lrc_search_compare_terms (gconstpointer a, gconstpointer b)
+{
+  return strcmp (*(const gchar **) a, *(const gchar **) b);
+}
+
+GstBuffer *
+gst_lrc_search_write (GstLrcSearch * search)
+{
+  GstBuffer *buf;
+  GPtrArray *terms;
+  GHashTableIter iter;
+  gpointer key;
+  GArray *postings;
+  const GstLrcSearchHit *hit;
+  guint8 *data, *rec, *post;
+  guint32 files_at, terms_at, postings_at, strings_at, strings_size;
+  guint32 first;
+  gsize len;
+  gchar *str;
+  guint i, j;
+
+  terms = g_ptr_array_new ();
+  g_hash_table_iter_init (&iter, search->terms);
+  while (g_hash_table_iter_next (&iter, &key, NULL))
+    g_ptr_array_add (terms, key);
+  g_ptr_array_sort (terms, gst_lrc_search_compare_terms);
+
+  strings_size = 0;
+  for (i = 0; i < search->names->len; i++)
+    strings_size += strlen (g_ptr_array_index (search->names, i)) + 1;
+  for (i = 0; i < terms->len; i++)
+    strings_size += strlen (g_ptr_array_index (terms, i)) + 1;
+
+  files_at = LRC_SEARCH_HEADER_SIZE;
+  terms_at = files_at + search->names->len * 4;
+  postings_at = terms_at + terms->len * LRC_SEARCH_TERM_SIZE;
+  strings_at = postings_at + search->n_postings * LRC_SEARCH_POSTING_SIZE;
+
+  buf = gst_buffer_new_and_alloc (strings_at + strings_size);
+  data = GST_BUFFER_DATA (buf);
+  memset (data, 0, LRC_SEARCH_HEADER_SIZE);
+  str = (gchar *) data + strings_at;
+
+  rec = data + files_at;
+  for (i = 0; i < search->names->len; i++, rec += 4) {
+    GST_WRITE_UINT32_LE (rec, str - ((gchar *) data + strings_at));
+    len = strlen (g_ptr_array_index (search->names, i)) + 1;
+    memcpy (str, g_ptr_array_index (search->names, i), len);
+    str += len;
+  }
+
+  rec = data + terms_at;
+  post = data + postings_at;
+  first = 0;
+  for (i = 0; i < terms->len; i++, rec += LRC_SEARCH_TERM_SIZE) {
+    postings = g_hash_table_lookup (search->terms,
+        g_ptr_array_index (terms, i));
+    GST_WRITE_UINT32_LE (rec, str - ((gchar *) data + strings_at));
+    GST_WRITE_UINT32_LE (rec + 4, first);
+    GST_WRITE_UINT32_LE (rec + 8, postings->len);
+    len = strlen (g_ptr_array_index (terms, i)) + 1;
+    memcpy (str, g_ptr_array_index (terms, i), len);
+    str += len;
+
+    for (j = 0; j < postings->len; j++, post += LRC_SEARCH_POSTING_SIZE) {
+      hit = &g_array_index (postings, GstLrcSearchHit, j);
+      GST_WRITE_UINT32_LE (post, hit->file);
+      GST_WRITE_UINT32_LE (post + 4, hit->cue);
+      GST_WRITE_UINT64_LE (post + 8, hit->time);
+    }
+    first += postings->len;
+  }
+  g_ptr_array_free (terms, TRUE);
+
+  memcpy (data, LRC_SEARCH_MAGIC, 4);
+  GST_WRITE_UINT16_LE (data + 4, LRC_SEARCH_VERSION);
+  GST_WRITE_UINT16_LE (data + 6, LRC_SEARCH_HEADER_SIZE);
+  GST_WRITE_UINT32_LE (data + 8, search->names->len);
+  GST_WRITE_UINT32_LE (data + 12, g_hash_table_size (search->terms));
+  GST_WRITE_UINT32_LE (data + 16, search->n_postings);
+  GST_WRITE_UINT32_LE (data + 20, strings_size);
+  GST_WRITE_UINT32_LE (data + 24,
+      gst_lrc_binary_adler32 (data + LRC_SEARCH_HEADER_SIZE,
+          GST_BUFFER_SIZE (buf) - LRC_SEARCH_HEADER_SIZE));
+  GST_WRITE_UINT32_LE (data + LRC_SEARCH_HEADER_CHECKSUM_OFFSET,
+      gst_lrc_binary_adler32 (data, LRC_SEARCH_HEADER_CHECKSUM_OFFSET));
+
+  return buf;
+}
+
+/* Load an index written by gst_lrc_search_write, more files can be added
+ * to it. NULL if buf is not a valid index. */
+GstLrcSearch *
+gst_lrc_search_read (GstBuffer * buf)
+{
+  const guint8 *data = GST_BUFFER_DATA (buf);
+  gsize size = GST_BUFFER_SIZE (buf);
+  GstLrcSearch *search;
+  GArray *postings;
+  GstLrcSearchHit hit;
+  const guint8 *rec, *post;
+  const gchar *strings;
+  guint32 header_size, n_files, n_terms, n_postings, strings_size;
+  guint32 offset, first, n;
+  guint64 total;
+  guint i, j;
+
+  if (size < LRC_SEARCH_HEADER_SIZE || memcmp (data, LRC_SEARCH_MAGIC, 4))
+    return NULL;
+
+  if (GST_READ_UINT16_LE (data + 4) != LRC_SEARCH_VERSION) {
+    GST_WARNING ("unsupported lyrics search index version %u",
+        GST_READ_UINT16_LE (data + 4));
+    return NULL;
+  }
+
+  header_size = GST_READ_UINT16_LE (data + 6);
+  n_files = GST_READ_UINT32_LE (data + 8);
+  n_terms = GST_READ_UINT32_LE (data + 12);
+  n_postings = GST_READ_UINT32_LE (data + 16);
+  strings_size = GST_READ_UINT32_LE (data + 20);
+  total = (guint64) header_size + (guint64) n_files * 4 +
+      (guint64) n_terms * LRC_SEARCH_TERM_SIZE +
+      (guint64) n_postings * LRC_SEARCH_POSTING_SIZE + strings_size;
+
+  if (header_size < LRC_SEARCH_HEADER_SIZE || total != size ||
+      GST_READ_UINT32_LE (data + LRC_SEARCH_HEADER_CHECKSUM_OFFSET) !=
+      gst_lrc_binary_adler32 (data, LRC_SEARCH_HEADER_CHECKSUM_OFFSET) ||
+      GST_READ_UINT32_LE (data + 24) !=
+      gst_lrc_binary_adler32 (data + header_size, size - header_size)) {
+    GST_WARNING ("corrupt lyrics search index");
+    return NULL;
+  }
+
+  /* every string offset below the size then reads a terminated string */
+  strings = (const gchar *) data + size - strings_size;
+  if (strings_size > 0 && strings[strings_size - 1] != '\0') {
+    GST_WARNING ("corrupt lyrics search index strings");
+    return NULL;
+  }
+
+  search = gst_lrc_search_new ();
+
+  rec = data + header_size;
+  for (i = 0; i < n_files; i++, rec += 4) {
+    offset = GST_READ_UINT32_LE (rec);
+    if (offset >= strings_size)
+      goto corrupt;
+    g_ptr_array_add (search->names, g_strdup (strings + offset));
+  }
+
+  post = rec + n_terms * LRC_SEARCH_TERM_SIZE;
+  for (i = 0; i < n_terms; i++, rec += LRC_SEARCH_TERM_SIZE) {
+    offset = GST_READ_UINT32_LE (rec);
+    first = GST_READ_UINT32_LE (rec + 4);
+    n = GST_READ_UINT32_LE (rec + 8);
+    if (offset >= strings_size || (guint64) first + n > n_postings ||
+        g_hash_table_lookup (search->terms, strings + offset))
+      goto corrupt;
+
+    postings = g_array_sized_new (FALSE, FALSE, sizeof (GstLrcSearchHit), n);
+    g_hash_table_insert (search->terms, g_strdup (strings + offset),
+        postings);
+    for (j = 0; j < n; j++) {
+      hit.file = GST_READ_UINT32_LE (post + (first + j) *
+          LRC_SEARCH_POSTING_SIZE);
+      hit.cue = GST_READ_UINT32_LE (post + (first + j) *
+          LRC_SEARCH_POSTING_SIZE + 4);
+      hit.time = GST_READ_UINT64_LE (post + (first + j) *
+          LRC_SEARCH_POSTING_SIZE + 8);
+      if (hit.file >= n_files)
+        goto corrupt;
+      g_array_append_val (postings, hit);
+    }
+    search->n_postings += n;
+  }
+
+  GST_DEBUG ("loaded %u files, %u words, %u postings", n_files, n_terms,
+      n_postings);
+  return search;
+
+corrupt:
+  GST_WARNING ("corrupt lyrics search index tables");
+  gst_lrc_search_free (search);
+  return NULL;
+}
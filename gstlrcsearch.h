@@ -0,0 +1,81 @@
+/* GStreamer
+ * Copyright (C) <2008> Zhao Liang <zlweb@163.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+
+#ifndef __GST_LRC_SEARCH_H__
+#define __GST_LRC_SEARCH_H__
+
+#include <gst/gst.h>
+#include "gstlrcparse.h"
+
+G_BEGIN_DECLS
+
+/* Inverted index of the words of parsed lyrics, for "jump to the line that
+ * says ..." and catalog search. Files are added as they are parsed and
+ * numbered in that order; every word maps to the cues it appears in. The
+ * index is not locked, add and query from one thread at a time. The
+ * gst-lrc-search tool builds and queries one from the command line.
+ *
+ * Persisted form, all fields little endian:
+ *
+ *   0  "LRCF"
+ *   4  guint16 version, guint16 header size
+ *   8  guint32 n_files, n_terms, n_postings, strings size,
+ *      payload checksum, header checksum
+ *  32  file table, n_files guint32 name offsets
+ *      term table, n_terms records of guint32 term offset,
+ *      guint32 first posting, guint32 n_postings, sorted by term
+ *      postings, n_postings records of guint32 file, guint32 cue,
+ *      guint64 time
+ *      strings, every name and term followed by a '\0'
+ *
+ * The checksums are Adler-32 as in the binary lyrics index. */
+
+#define LRC_SEARCH_MAGIC        "LRCF"
+#define LRC_SEARCH_VERSION      1
+#define LRC_SEARCH_HEADER_SIZE  32
+
+/* A cue of a file containing all words of a query. time is the start of
+ * the cue, ready for a seek in lrcdemux. */
+typedef struct _GstLrcSearchHit {
+  guint32        file;
+  guint32        cue;
+  GstClockTime   time;
+} GstLrcSearchHit;
+
+typedef struct _GstLrcSearch GstLrcSearch;
+
+GstLrcSearch *  gst_lrc_search_new          (void);
+void            gst_lrc_search_free         (GstLrcSearch * search);
+guint           gst_lrc_search_add          (GstLrcSearch * search,
+                                             const gchar * name,
+                                             const GstLrcIndex * index);
+guint           gst_lrc_search_get_n_files  (GstLrcSearch * search);
+const gchar *   gst_lrc_search_get_name     (GstLrcSearch * search,
+                                             guint file);
+GArray *        gst_lrc_search_query        (GstLrcSearch * search,
+                                             const gchar * text, gint file);
+GstEvent *      gst_lrc_search_hit_seek     (const GstLrcSearchHit * hit);
+
+GstBuffer *     gst_lrc_search_write        (GstLrcSearch * search);
+GstLrcSearch *  gst_lrc_search_read         (GstBuffer * buf);
+
+G_END_DECLS
+
+#endif /* __GST_LRC_SEARCH_H__ */
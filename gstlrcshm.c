@@ -0,0 +1,162 @@
+/* GStreamer
+ * Copyright (C) <2008> Zhao Liang <zlweb@163.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include "gstlrcshm.h"
+#include "gstlrcparse.h"
+
+#define GST_CAT_DEFAULT lrcparse_debug
+
+struct _GstLrcShm {
+  gchar         *name;
+  gint           fd;
+  GstLrcShmHeader *header;
+  guint8        *area;
+  gsize          size;
+};
+
+/* A segment of ours whose writer is gone. Anything else under the name,
+ * including a segment that is still being set up, is left alone. */
+static gboolean
+gst_lrc_shm_is_stale (const gchar * name)
+{
+  GstLrcShmHeader *header;
+  struct stat st;
+  gboolean stale = FALSE;
+  gint fd;
+
+  fd = shm_open (name, O_RDONLY, 0);
+  if (fd < 0)
+    return FALSE;
+
+  if (fstat (fd, &st) == 0 && st.st_size >= sizeof (GstLrcShmHeader) &&
+      (header = mmap (NULL, sizeof (GstLrcShmHeader), PROT_READ, MAP_SHARED,
+              fd, 0)) != MAP_FAILED) {
+    stale = memcmp (header->magic, LRC_SHM_MAGIC, 4) == 0 &&
+        kill ((pid_t) header->pid, 0) < 0 && errno == ESRCH;
+    munmap (header, sizeof (GstLrcShmHeader));
+  }
+  close (fd);
+
+  return stale;
+}
+
+/* Create the segment, name is a shm_open() name like "/lrcsink". Fails
+ * while another writer has it. */
+GstLrcShm *
+gst_lrc_shm_new (const gchar * name)
+{
+  GstLrcShm *shm;
+  gpointer base;
+  gsize size;
+  gint fd;
+
+  size = sizeof (GstLrcShmHeader) + LRC_SHM_AREA_SIZE;
+
+  fd = shm_open (name, O_CREAT | O_EXCL | O_RDWR, 0644);
+  if (fd < 0 && errno == EEXIST && gst_lrc_shm_is_stale (name)) {
+    GST_DEBUG ("taking over the stale shared memory %s", name);
+    shm_unlink (name);
+    fd = shm_open (name, O_CREAT | O_EXCL | O_RDWR, 0644);
+  }
+  if (fd < 0) {
+    GST_WARNING ("could not create shared memory %s: %s", name,
+        g_strerror (errno));
+    return NULL;
+  }
+
+  if (ftruncate (fd, size) < 0 ||
+      (base = mmap (NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd,
+              0)) == MAP_FAILED) {
+    GST_WARNING ("could not map shared memory %s: %s", name,
+        g_strerror (errno));
+    close (fd);
+    shm_unlink (name);
+    return NULL;
+  }
+
+  shm = g_slice_new (GstLrcShm);
+  shm->name = g_strdup (name);
+  shm->fd = fd;
+  shm->header = base;
+  shm->area = (guint8 *) base + sizeof (GstLrcShmHeader);
+  shm->size = size;
+
+  /* readers check the magic last */
+  memset (base, 0, size);
+  shm->header->version = LRC_SHM_VERSION;
+  shm->header->area_size = LRC_SHM_AREA_SIZE;
+  shm->header->pid = getpid ();
+  shm->header->lines[LRC_SHM_CURRENT].start = G_MAXUINT64;
+  shm->header->lines[LRC_SHM_NEXT].start = G_MAXUINT64;
+  g_atomic_int_set (&shm->header->seq, 0);
+  memcpy (shm->header->magic, LRC_SHM_MAGIC, 4);
+
+  GST_DEBUG ("exporting lyrics to %s, %" G_GSIZE_FORMAT " bytes", name, size);
+  return shm;
+}
+
+/* Readers that still have the segment mapped keep their copy. */
+void
+gst_lrc_shm_free (GstLrcShm * shm)
+{
+  munmap (shm->header, shm->size);
+  close (shm->fd);
+  shm_unlink (shm->name);
+  g_free (shm->name);
+  g_slice_free (GstLrcShm, shm);
+}
+
+/* Each line is written into its own slot. A reader copying that slot
+ * meanwhile sees seq change and retries, the other line stays intact. */
+void
+gst_lrc_shm_publish (GstLrcShm * shm, guint which, GstClockTime start,
+    GstClockTime stop, const gchar * text, gsize len)
+{
+  GstLrcShmLine *line = &shm->header->lines[which];
+  guint32 offset = which * LRC_SHM_SLOT_SIZE;
+
+  len = gst_lrc_text_clamp (text, len, LRC_SHM_MAX_TEXT);
+
+  /* the increments are full barriers, readers see an odd seq meanwhile */
+  g_atomic_int_inc (&shm->header->seq);
+
+  memcpy (shm->area + offset, text, len);
+  shm->area[offset + len] = '\0';
+  line->start = GST_CLOCK_TIME_IS_VALID (start) ? start : G_MAXUINT64;
+  line->stop = GST_CLOCK_TIME_IS_VALID (stop) ? stop : G_MAXUINT64;
+  line->offset = offset;
+  line->length = len;
+  if (which == LRC_SHM_CURRENT)
+    shm->header->changes++;
+
+  g_atomic_int_inc (&shm->header->seq);
+}
@@ -0,0 +1,82 @@
+/* GStreamer
+ * Copyright (C) <2008> Zhao Liang <zlweb@163.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+
+#ifndef __GST_LRC_SHM_H__
+#define __GST_LRC_SHM_H__
+
+#include <gst/gst.h>
+
+G_BEGIN_DECLS
+
+/* Shared memory export of the lines lrcsink shows, for readers in other
+ * processes. The segment is a GstLrcShmHeader followed by a text area of
+ * area_size bytes. The area is split in one fixed slot per line, so
+ * publishing one line never overwrites the text of the other. Each text
+ * is stored NUL terminated at the offset its GstLrcShmLine gives.
+ *
+ * The sink is the only writer. It increments seq before and after each
+ * update, so a reader copies what it needs while seq is even and retries
+ * if seq changed meanwhile. All fields are in host byte order.
+ *
+ * A name has one writer: a second lrcsink with the same name fails to
+ * start. A segment left behind by a writer that died is taken over. */
+
+#define LRC_SHM_MAGIC "LRCS"
+#define LRC_SHM_VERSION 1
+#define LRC_SHM_AREA_SIZE (64 * 1024)
+
+/* one slot per line, longer texts are cut */
+#define LRC_SHM_SLOT_SIZE (LRC_SHM_AREA_SIZE / 2)
+#define LRC_SHM_MAX_TEXT (LRC_SHM_SLOT_SIZE - 1)
+
+#define LRC_SHM_CURRENT 0
+#define LRC_SHM_NEXT 1
+
+typedef struct _GstLrcShmLine {
+  guint64        start;         /* G_MAXUINT64 when there is no line */
+  guint64        stop;          /* G_MAXUINT64 when unknown */
+  guint32        offset;        /* of the text in the text area */
+  guint32        length;        /* of the text without the NUL */
+} GstLrcShmLine;
+
+typedef struct _GstLrcShmHeader {
+  gchar          magic[4];
+  guint32        version;
+  guint32        area_size;
+  guint32        pid;           /* of the writer */
+  volatile gint  seq;
+
+  /* counts the changes of the current line */
+  guint64        changes;
+  GstLrcShmLine  lines[2];
+} GstLrcShmHeader;
+
+typedef struct _GstLrcShm GstLrcShm;
+
+GstLrcShm *     gst_lrc_shm_new             (const gchar * name);
+void            gst_lrc_shm_free            (GstLrcShm * shm);
+void            gst_lrc_shm_publish         (GstLrcShm * shm, guint which,
+                                             GstClockTime start,
+                                             GstClockTime stop,
+                                             const gchar * text, gsize len);
+
+G_END_DECLS
+
+#endif /* __GST_LRC_SHM_H__ */
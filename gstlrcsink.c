@@ -49,10 +49,40 @@
 
 #include <string.h>
 #include "gstlrcsink.h"
+#include "gstlrcparse.h"
 
 GST_DEBUG_CATEGORY_STATIC (lrcsink_debug);
 #define GST_CAT_DEFAULT lrcsink_debug
 
+enum
+{
+  SIGNAL_LINE_CHANGED,
+  LAST_SIGNAL
+};
+
+enum
+{
+  PROP_0,
+  PROP_EMIT_SIGNALS,
+  PROP_CURRENT_LINE,
+  PROP_NEXT_LINE,
+  PROP_SHM_NAME,
+  PROP_DROP_SUPERSEDED,
+  PROP_RENDERED,
+  PROP_DROPPED,
+  PROP_LATE,
+  PROP_WORST_LATENESS,
+  PROP_MASTER
+};
+
+#define DEFAULT_EMIT_SIGNALS FALSE
+#define DEFAULT_DROP_SUPERSEDED FALSE
+
+#define LRC_SINK_CURRENT 0
+#define LRC_SINK_NEXT 1
+
+static guint gst_lrc_sink_signals[LAST_SIGNAL] = { 0 };
+
 static GstStaticPadTemplate sinktemplate = GST_STATIC_PAD_TEMPLATE ("sink",
     GST_PAD_SINK,
     GST_PAD_ALWAYS,
@@ -63,12 +93,20 @@ static void gst_lrc_sink_base_init (GstLrcSinkClass * klass);
 static void gst_lrc_sink_class_init (GstLrcSinkClass * klass);
 static void gst_lrc_sink_init (GstLrcSink * lrc, GstLrcSinkClass * gclass);
 static void gst_lrc_sink_finalize (GObject * object);
+static void gst_lrc_sink_set_property (GObject * object, guint prop_id,
+    const GValue * value, GParamSpec * pspec);
+static void gst_lrc_sink_get_property (GObject * object, guint prop_id,
+    GValue * value, GParamSpec * pspec);
 
 static GstStateChangeReturn gst_lrc_sink_change_state (GstElement * element,
     GstStateChange transition);
 
 static GstFlowReturn gst_lrc_sink_render (GstBaseSink * bsink,
     GstBuffer * buffer);
+static void gst_lrc_sink_get_times (GstBaseSink * bsink, GstBuffer * buffer,
+    GstClockTime * start, GstClockTime * end);
+static GstClock *gst_lrc_sink_provide_clock (GstElement * element);
+static void gst_lrc_sink_watch_master (GstLrcSink * lrc, GstElement * master);
 
 static GstElementClass *parent_class = NULL;
 
@@ -130,11 +168,73 @@ gst_lrc_sink_class_init (GstLrcSinkClass * klass)
       gst_static_pad_template_get (&sinktemplate));
 
   gobject_class->finalize = gst_lrc_sink_finalize;
-  
+  gobject_class->set_property = gst_lrc_sink_set_property;
+  gobject_class->get_property = gst_lrc_sink_get_property;
+
+  g_object_class_install_property (gobject_class, PROP_EMIT_SIGNALS,
+      g_param_spec_boolean ("emit-signals", "Emit signals",
+          "Emit line-changed signals from the default main context",
+          DEFAULT_EMIT_SIGNALS, G_PARAM_READWRITE));
+  g_object_class_install_property (gobject_class, PROP_CURRENT_LINE,
+      g_param_spec_string ("current-line", "Current line",
+          "Text of the line showing now", NULL, G_PARAM_READABLE));
+  g_object_class_install_property (gobject_class, PROP_NEXT_LINE,
+      g_param_spec_string ("next-line", "Next line",
+          "Text of the line that shows next, if it arrived already", NULL,
+          G_PARAM_READABLE));
+  g_object_class_install_property (gobject_class, PROP_SHM_NAME,
+      g_param_spec_string ("shm-name", "Shared memory name",
+          "Export the current and the next line to the shared memory "
+          "segment of this name (like /lrcsink), NULL to disable", NULL,
+          G_PARAM_READWRITE));
+  g_object_class_install_property (gobject_class, PROP_DROP_SUPERSEDED,
+      g_param_spec_boolean ("drop-superseded", "Drop superseded",
+          "Drop lines that arrive after their stop time so that the display "
+          "jumps to the line due now", DEFAULT_DROP_SUPERSEDED,
+          G_PARAM_READWRITE));
+  g_object_class_install_property (gobject_class, PROP_RENDERED,
+      g_param_spec_uint64 ("rendered", "Rendered",
+          "Number of lines shown", 0, G_MAXUINT64, 0, G_PARAM_READABLE));
+  g_object_class_install_property (gobject_class, PROP_DROPPED,
+      g_param_spec_uint64 ("dropped", "Dropped",
+          "Number of superseded lines dropped", 0, G_MAXUINT64, 0,
+          G_PARAM_READABLE));
+  g_object_class_install_property (gobject_class, PROP_LATE,
+      g_param_spec_uint64 ("late", "Late",
+          "Number of lines that arrived too late, shown or not", 0,
+          G_MAXUINT64, 0, G_PARAM_READABLE));
+  g_object_class_install_property (gobject_class, PROP_WORST_LATENESS,
+      g_param_spec_int64 ("worst-lateness", "Worst lateness",
+          "Largest lateness of a line in nanoseconds", G_MININT64,
+          G_MAXINT64, 0, G_PARAM_READABLE));
+  g_object_class_install_property (gobject_class, PROP_MASTER,
+      g_param_spec_object ("master", "Master",
+          "Element of another pipeline, usually the audio sink, whose clock "
+          "and running time the lyrics follow. Overrides ts-offset",
+          GST_TYPE_ELEMENT, G_PARAM_READWRITE));
+
+  /**
+   * GstLrcSink::line-changed:
+   * @sink: the sink
+   * @text: the text of the line showing now
+   *
+   * Emitted from the default main context when another line shows. Changes
+   * that happen before the main loop gets to run are merged into one
+   * emission, use gst_lrc_sink_get_lines() for the times.
+   */
+  gst_lrc_sink_signals[SIGNAL_LINE_CHANGED] =
+      g_signal_new ("line-changed", G_TYPE_FROM_CLASS (klass),
+      G_SIGNAL_RUN_LAST, G_STRUCT_OFFSET (GstLrcSinkClass, line_changed),
+      NULL, NULL, g_cclosure_marshal_VOID__STRING, G_TYPE_NONE, 1,
+      G_TYPE_STRING);
+
   gstelement_class->change_state =
       GST_DEBUG_FUNCPTR (gst_lrc_sink_change_state);
+  gstelement_class->provide_clock =
+      GST_DEBUG_FUNCPTR (gst_lrc_sink_provide_clock);
 
   gstbase_sink_class->render = GST_DEBUG_FUNCPTR (gst_lrc_sink_render);
+  gstbase_sink_class->get_times = GST_DEBUG_FUNCPTR (gst_lrc_sink_get_times);
 }
 
 static void
@@ -147,6 +247,22 @@ gst_lrc_sink_init (GstLrcSink * lrc, GstLrcSinkClass * gclass)
 //  lrc->sinkpad = gst_pad_new_from_static_template (&sinktemplate, "sink");
 //  gst_element_add_pad (GST_ELEMENT (lrc), lrc->sinkpad);
 
+  lrc->emit_signals = DEFAULT_EMIT_SIGNALS;
+  lrc->seq = 0;
+  lrc->lines[LRC_SINK_CURRENT].start = GST_CLOCK_TIME_NONE;
+  lrc->lines[LRC_SINK_NEXT].start = GST_CLOCK_TIME_NONE;
+  lrc->signal_pending = 0;
+  lrc->shm_name = NULL;
+  lrc->shm = NULL;
+  lrc->drop_superseded = DEFAULT_DROP_SUPERSEDED;
+  lrc->rendered = lrc->dropped = lrc->late = 0;
+  lrc->worst_lateness = 0;
+  lrc->master = NULL;
+  lrc->master_pad = NULL;
+  lrc->master_probe = 0;
+  lrc->master_flushed = 0;
+
+  gst_base_sink_set_qos_enabled (GST_BASE_SINK (lrc), TRUE);
 }
 
 static void
@@ -156,13 +272,527 @@ gst_lrc_sink_finalize (GObject * object)
 
   GST_DEBUG ("lrc: finalize");
 
+  g_free (lrc->shm_name);
+  gst_lrc_sink_watch_master (lrc, NULL);
+  if (lrc->master)
+    gst_object_unref (lrc->master);
+
   G_OBJECT_CLASS (parent_class)->finalize (object);
 }
 
+static void
+gst_lrc_sink_set_property (GObject * object, guint prop_id,
+    const GValue * value, GParamSpec * pspec)
+{
+  GstLrcSink *lrc = GST_LRC_SINK (object);
+  GstElement *master, *old_master;
+
+  switch (prop_id) {
+    case PROP_EMIT_SIGNALS:
+      lrc->emit_signals = g_value_get_boolean (value);
+      break;
+    case PROP_SHM_NAME:
+      GST_OBJECT_LOCK (lrc);
+      g_free (lrc->shm_name);
+      lrc->shm_name = g_value_dup_string (value);
+      GST_OBJECT_UNLOCK (lrc);
+      break;
+    case PROP_DROP_SUPERSEDED:
+      lrc->drop_superseded = g_value_get_boolean (value);
+      break;
+    case PROP_MASTER:
+      master = g_value_dup_object (value);
+      gst_lrc_sink_watch_master (lrc, master);
+      GST_OBJECT_LOCK (lrc);
+      old_master = lrc->master;
+      lrc->master = master;
+      /* let the pipeline pick the clock of the master */
+      if (lrc->master)
+        GST_OBJECT_FLAG_SET (lrc, GST_ELEMENT_PROVIDE_CLOCK);
+      else
+        GST_OBJECT_FLAG_UNSET (lrc, GST_ELEMENT_PROVIDE_CLOCK);
+      GST_OBJECT_UNLOCK (lrc);
+      if (old_master)
+        gst_object_unref (old_master);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+      break;
+  }
+}
+
+static void
+gst_lrc_sink_get_property (GObject * object, guint prop_id, GValue * value,
+    GParamSpec * pspec)
+{
+  GstLrcSink *lrc = GST_LRC_SINK (object);
+  GstLrcSinkLine lines[2];
+
+  switch (prop_id) {
+    case PROP_EMIT_SIGNALS:
+      g_value_set_boolean (value, lrc->emit_signals);
+      break;
+    case PROP_SHM_NAME:
+      GST_OBJECT_LOCK (lrc);
+      g_value_set_string (value, lrc->shm_name);
+      GST_OBJECT_UNLOCK (lrc);
+      break;
+    case PROP_DROP_SUPERSEDED:
+      g_value_set_boolean (value, lrc->drop_superseded);
+      break;
+    case PROP_RENDERED:
+      GST_OBJECT_LOCK (lrc);
+      g_value_set_uint64 (value, lrc->rendered);
+      GST_OBJECT_UNLOCK (lrc);
+      break;
+    case PROP_DROPPED:
+      GST_OBJECT_LOCK (lrc);
+      g_value_set_uint64 (value, lrc->dropped);
+      GST_OBJECT_UNLOCK (lrc);
+      break;
+    case PROP_LATE:
+      GST_OBJECT_LOCK (lrc);
+      g_value_set_uint64 (value, lrc->late);
+      GST_OBJECT_UNLOCK (lrc);
+      break;
+    case PROP_WORST_LATENESS:
+      GST_OBJECT_LOCK (lrc);
+      g_value_set_int64 (value, lrc->worst_lateness);
+      GST_OBJECT_UNLOCK (lrc);
+      break;
+    case PROP_MASTER:
+      GST_OBJECT_LOCK (lrc);
+      g_value_set_object (value, lrc->master);
+      GST_OBJECT_UNLOCK (lrc);
+      break;
+    case PROP_CURRENT_LINE:
+    case PROP_NEXT_LINE:
+      gst_lrc_sink_get_lines (lrc, &lines[LRC_SINK_CURRENT],
+          &lines[LRC_SINK_NEXT]);
+      if (prop_id == PROP_CURRENT_LINE)
+        g_value_set_string (value, GST_CLOCK_TIME_IS_VALID (lines[0].start) ?
+            lines[0].text : NULL);
+      else
+        g_value_set_string (value, GST_CLOCK_TIME_IS_VALID (lines[1].start) ?
+            lines[1].text : NULL);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+      break;
+  }
+}
+
+/**
+ * gst_lrc_sink_get_lines:
+ * @sink: a #GstLrcSink
+ * @current: the line showing now, or NULL
+ * @next: the line that shows next, or NULL
+ *
+ * Copy the current and the next line without taking any lock, cheap enough
+ * to call for every frame of a user interface. A line that is not known
+ * has a start of GST_CLOCK_TIME_NONE.
+ *
+ * Returns: TRUE if a line is showing.
+ */
+gboolean
+gst_lrc_sink_get_lines (GstLrcSink * sink, GstLrcSinkLine * current,
+    GstLrcSinkLine * next)
+{
+  GstLrcSinkLine lines[2];
+  gint seq;
+
+  /* the atomic reads are full barriers, the copy can not move out */
+  do {
+    while ((seq = g_atomic_int_get (&sink->seq)) & 1);
+    memcpy (lines, (const GstLrcSinkLine *) sink->lines, sizeof (lines));
+  } while (g_atomic_int_get (&sink->seq) != seq);
+
+  if (current)
+    *current = lines[LRC_SINK_CURRENT];
+  if (next)
+    *next = lines[LRC_SINK_NEXT];
+  return GST_CLOCK_TIME_IS_VALID (lines[LRC_SINK_CURRENT].start);
+}
+
+/* the text ends at the NUL, enhanced lrc word times follow it */
+static gsize
+gst_lrc_sink_text_length (GstBuffer * buf)
+{
+  const guint8 *nul;
+
+  if (GST_BUFFER_SIZE (buf) == 0)
+    return 0;
+  nul = memchr (GST_BUFFER_DATA (buf), '\0', GST_BUFFER_SIZE (buf));
+  return nul ? nul - GST_BUFFER_DATA (buf) : GST_BUFFER_SIZE (buf);
+}
+
+static void
+gst_lrc_sink_line_set (GstLrcSinkLine * line, GstBuffer * buf)
+{
+  gsize len;
+
+  if (!buf) {
+    line->start = GST_CLOCK_TIME_NONE;
+    line->stop = GST_CLOCK_TIME_NONE;
+    line->text[0] = '\0';
+    return;
+  }
+
+  line->start = GST_BUFFER_TIMESTAMP (buf);
+  line->stop = GST_BUFFER_DURATION_IS_VALID (buf) ?
+      line->start + GST_BUFFER_DURATION (buf) : GST_CLOCK_TIME_NONE;
+
+  len = gst_lrc_text_clamp ((const gchar *) GST_BUFFER_DATA (buf),
+      gst_lrc_sink_text_length (buf), LRC_SINK_TEXT_SIZE - 1);
+  memcpy (line->text, GST_BUFFER_DATA (buf), len);
+  line->text[len] = '\0';
+}
+
+/* Only called from the streaming thread. The increments are full barriers,
+ * readers see an odd seq while the lines change. */
+static void
+gst_lrc_sink_publish (GstLrcSink * lrc, gint which, GstBuffer * buf)
+{
+  gboolean next_shown;
+
+  g_atomic_int_inc (&lrc->seq);
+  gst_lrc_sink_line_set (&lrc->lines[which], buf);
+  /* the next line became the current one */
+  next_shown = which == LRC_SINK_CURRENT && buf &&
+      lrc->lines[LRC_SINK_NEXT].start == GST_BUFFER_TIMESTAMP (buf);
+  if (next_shown)
+    gst_lrc_sink_line_set (&lrc->lines[LRC_SINK_NEXT], NULL);
+  g_atomic_int_inc (&lrc->seq);
+
+  if (!lrc->shm)
+    return;
+
+  /* the full text goes to the shared ring, it is not cut to the slot */
+  if (buf)
+    gst_lrc_shm_publish (lrc->shm, which, lrc->lines[which].start,
+        lrc->lines[which].stop, (const gchar *) GST_BUFFER_DATA (buf),
+        gst_lrc_sink_text_length (buf));
+  else
+    gst_lrc_shm_publish (lrc->shm, which, GST_CLOCK_TIME_NONE,
+        GST_CLOCK_TIME_NONE, "", 0);
+  if (next_shown)
+    gst_lrc_shm_publish (lrc->shm, LRC_SINK_NEXT, GST_CLOCK_TIME_NONE,
+        GST_CLOCK_TIME_NONE, "", 0);
+}
+
+static gboolean
+gst_lrc_sink_emit_line_changed (gpointer data)
+{
+  GstLrcSink *lrc = GST_LRC_SINK (data);
+  GstLrcSinkLine line;
+
+  g_atomic_int_set (&lrc->signal_pending, 0);
+  if (gst_lrc_sink_get_lines (lrc, &line, NULL))
+    g_signal_emit (lrc, gst_lrc_sink_signals[SIGNAL_LINE_CHANGED], 0,
+        line.text);
+
+  return FALSE;
+}
+
+static GstClock *
+gst_lrc_sink_get_element_clock (GstElement * element, GstClockTime * base)
+{
+  GstClock *clock;
+
+  GST_OBJECT_LOCK (element);
+  if ((clock = GST_ELEMENT_CLOCK (element)))
+    gst_object_ref (clock);
+  *base = element->base_time;
+  GST_OBJECT_UNLOCK (element);
+
+  return clock;
+}
+
+static GstClock *
+gst_lrc_sink_provide_clock (GstElement * element)
+{
+  GstLrcSink *lrc = GST_LRC_SINK (element);
+  GstClock *clock = NULL;
+  GstClockTime base;
+
+  GST_OBJECT_LOCK (lrc);
+  if (lrc->master)
+    clock = gst_lrc_sink_get_element_clock (lrc->master, &base);
+  GST_OBJECT_UNLOCK (lrc);
+
+  return clock;
+}
+
+/* A flushing seek of the master restarts it at the stream time of its new
+ * segment. Our pipeline is seeked there as well, which also wakes up a
+ * line that is waiting for its time already. Called from the streaming
+ * thread of the master. */
+static gboolean
+gst_lrc_sink_master_event (GstPad * pad, GstEvent * event, GstLrcSink * lrc)
+{
+  GstFormat format;
+  gboolean update;
+  gdouble rate;
+  gint64 start, stop, time;
+
+  switch (GST_EVENT_TYPE (event)) {
+    case GST_EVENT_FLUSH_STOP:
+      g_atomic_int_set (&lrc->master_flushed, 1);
+      break;
+    case GST_EVENT_NEWSEGMENT:
+      gst_event_parse_new_segment (event, &update, &rate, &format, &start,
+          &stop, &time);
+      if (format != GST_FORMAT_TIME ||
+          !g_atomic_int_compare_and_exchange (&lrc->master_flushed, 1, 0))
+        break;
+
+      GST_DEBUG_OBJECT (lrc, "master restarted at %" GST_TIME_FORMAT,
+          GST_TIME_ARGS (time));
+      gst_element_send_event (GST_ELEMENT_CAST (lrc),
+          gst_event_new_seek (1.0, GST_FORMAT_TIME, GST_SEEK_FLAG_FLUSH,
+              GST_SEEK_TYPE_SET, time, GST_SEEK_TYPE_NONE, -1));
+      break;
+    default:
+      break;
+  }
+
+  return TRUE;
+}
+
+/* move the probe to the sink pad of master, if it has one */
+static void
+gst_lrc_sink_watch_master (GstLrcSink * lrc, GstElement * master)
+{
+  if (lrc->master_pad) {
+    gst_pad_remove_event_probe (lrc->master_pad, lrc->master_probe);
+    gst_object_unref (lrc->master_pad);
+    lrc->master_pad = NULL;
+  }
+  g_atomic_int_set (&lrc->master_flushed, 0);
+
+  if (master && (lrc->master_pad = gst_element_get_static_pad (master,
+              "sink")))
+    lrc->master_probe = gst_pad_add_event_probe (lrc->master_pad,
+        G_CALLBACK (gst_lrc_sink_master_event), lrc);
+}
+
+/* The running time at which the master plays stream time in segment, 0
+ * when that is behind it already so that the line is late. */
+static GstClockTime
+gst_lrc_sink_master_running_time (GstSegment * segment, GstClockTime stream)
+{
+  GstClockTime running;
+
+  if (!GST_CLOCK_TIME_IS_VALID (stream) || stream < segment->time)
+    return 0;
+
+  running = gst_segment_to_running_time (segment, GST_FORMAT_TIME,
+      segment->start + (stream - segment->time));
+  return GST_CLOCK_TIME_IS_VALID (running) ? running : 0;
+}
+
+/* Set ts-offset so that the line in buffer is due when the master plays
+ * its stream time. Worked out again for every line before basesink waits,
+ * from the current segment and base time of the master, so lines follow
+ * its seeks, rate and pauses; a master that is not a basesink is assumed
+ * to run in step with our segment. A line waiting already is only moved
+ * by a flushing seek, see gst_lrc_sink_master_event(), a pause of the
+ * master that does not stop the clock delays the next line only. When the
+ * clocks differ their offset is sampled once per line, drift between two
+ * lines is not corrected. */
+static void
+gst_lrc_sink_follow_master (GstLrcSink * lrc, GstBuffer * buffer)
+{
+  GstBaseSink *bsink = GST_BASE_SINK (lrc);
+  GstElement *master;
+  GstClock *clock, *master_clock;
+  GstClockTime base, master_base;
+  GstClockTime before, after, master_now;
+  GstClockTime running, master_running;
+  GstClockTimeDiff offset;
+  GstSegment segment;
+  gboolean have_segment = FALSE;
+
+  if (!GST_BUFFER_TIMESTAMP_IS_VALID (buffer))
+    return;
+
+  GST_OBJECT_LOCK (lrc);
+  if ((master = lrc->master))
+    gst_object_ref (master);
+  GST_OBJECT_UNLOCK (lrc);
+  if (!master)
+    return;
+
+  master_clock = gst_lrc_sink_get_element_clock (master, &master_base);
+  clock = gst_lrc_sink_get_element_clock (GST_ELEMENT_CAST (lrc), &base);
+  if (GST_IS_BASE_SINK (master)) {
+    GST_OBJECT_LOCK (master);
+    segment = GST_BASE_SINK (master)->segment;
+    GST_OBJECT_UNLOCK (master);
+    have_segment = segment.format == GST_FORMAT_TIME;
+  }
+  gst_object_unref (master);
+
+  if (!clock || !master_clock)
+    goto done;
+
+  /* lines outside our segment are not shown anyway */
+  running = gst_segment_to_running_time (&bsink->segment, GST_FORMAT_TIME,
+      GST_BUFFER_TIMESTAMP (buffer));
+  if (!GST_CLOCK_TIME_IS_VALID (running))
+    goto done;
+
+  master_running = running;
+  if (have_segment)
+    master_running = gst_lrc_sink_master_running_time (&segment,
+        gst_segment_to_stream_time (&bsink->segment, GST_FORMAT_TIME,
+            GST_BUFFER_TIMESTAMP (buffer)));
+
+  offset = GST_CLOCK_DIFF (base + running, master_base + master_running);
+  if (clock != master_clock) {
+    /* sample the master between two reads of our clock, the midpoint
+     * halves the error of the pair */
+    before = gst_clock_get_time (clock);
+    master_now = gst_clock_get_time (master_clock);
+    after = gst_clock_get_time (clock);
+    offset += GST_CLOCK_DIFF (master_now, before + (after - before) / 2);
+  }
+
+  GST_LOG_OBJECT (lrc, "offset to master %" G_GINT64_FORMAT " ns", offset);
+  gst_base_sink_set_ts_offset (bsink, offset);
+
+done:
+  if (clock)
+    gst_object_unref (clock);
+  if (master_clock)
+    gst_object_unref (master_clock);
+}
+
+static void
+gst_lrc_sink_get_times (GstBaseSink * bsink, GstBuffer * buffer,
+    GstClockTime * start, GstClockTime * end)
+{
+  GstLrcSink *lrc = GST_LRC_SINK (bsink);
+
+  gst_lrc_sink_follow_master (lrc, buffer);
+
+  GST_BASE_SINK_CLASS (parent_class)->get_times (bsink, buffer, start, end);
+
+  /* asked before waiting for the clock, the buffer shows next */
+  if (GST_BUFFER_TIMESTAMP_IS_VALID (buffer) &&
+      GST_BUFFER_TIMESTAMP (buffer) != lrc->lines[LRC_SINK_CURRENT].start)
+    gst_lrc_sink_publish (lrc, LRC_SINK_NEXT, buffer);
+}
+
+/* How late the buffer is rendered compared to the clock, positive when
+ * late. FALSE when there is no clock to compare with. */
+static gboolean
+gst_lrc_sink_get_lateness (GstLrcSink * lrc, GstBuffer * buffer,
+    GstClockTime * running, GstClockTimeDiff * lateness)
+{
+  GstBaseSink *bsink = GST_BASE_SINK (lrc);
+  GstClock *clock;
+  GstClockTime base_time, now;
+  GstClockTimeDiff offset;
+
+  if (!GST_BUFFER_TIMESTAMP_IS_VALID (buffer))
+    return FALSE;
+
+  *running = gst_segment_to_running_time (&bsink->segment, GST_FORMAT_TIME,
+      GST_BUFFER_TIMESTAMP (buffer));
+  if (!GST_CLOCK_TIME_IS_VALID (*running))
+    return FALSE;
+
+  GST_OBJECT_LOCK (lrc);
+  if ((clock = GST_ELEMENT_CLOCK (lrc)))
+    gst_object_ref (clock);
+  base_time = GST_ELEMENT_CAST (lrc)->base_time;
+  GST_OBJECT_UNLOCK (lrc);
+
+  if (!clock)
+    return FALSE;
+
+  now = gst_clock_get_time (clock);
+  gst_object_unref (clock);
+
+  /* the same target time as the sync of basesink */
+  offset = gst_base_sink_get_ts_offset (bsink);
+  *lateness = GST_CLOCK_DIFF ((GstClockTime) (*running + base_time +
+          gst_base_sink_get_latency (bsink) + offset), now);
+  return TRUE;
+}
+
+/* tell the application about a dropped line, qos messages came with
+ * 0.10.29; the counters are kept either way */
+static void
+gst_lrc_sink_post_qos (GstLrcSink * lrc, GstBuffer * buffer,
+    GstClockTime running, GstClockTimeDiff lateness)
+{
+#if GST_CHECK_VERSION (0, 10, 29)
+  GstBaseSink *bsink = GST_BASE_SINK (lrc);
+  GstMessage *msg;
+  guint64 rendered, dropped;
+
+  GST_OBJECT_LOCK (lrc);
+  rendered = lrc->rendered;
+  dropped = lrc->dropped;
+  GST_OBJECT_UNLOCK (lrc);
+
+  msg = gst_message_new_qos (GST_OBJECT_CAST (lrc), FALSE, running,
+      gst_segment_to_stream_time (&bsink->segment, GST_FORMAT_TIME,
+          GST_BUFFER_TIMESTAMP (buffer)), GST_BUFFER_TIMESTAMP (buffer),
+      GST_BUFFER_DURATION (buffer));
+  gst_message_set_qos_values (msg, lateness, 1.0, 1000000);
+  gst_message_set_qos_stats (msg, GST_FORMAT_BUFFERS, rendered + dropped,
+      dropped);
+  gst_element_post_message (GST_ELEMENT_CAST (lrc), msg);
+#endif
+}
+
 static GstFlowReturn gst_lrc_sink_render (GstBaseSink * bsink, GstBuffer * buffer)
 {
+  GstLrcSink *lrc = GST_LRC_SINK (bsink);
+  GstClockTime running;
+  GstClockTimeDiff lateness;
+  gboolean superseded = FALSE;
+
   GST_DEBUG("lyric: %s .", GST_BUFFER_DATA(buffer));
-  
+
+  if (gst_lrc_sink_get_lateness (lrc, buffer, &running, &lateness)) {
+    /* the next line is due already, showing this one only adds lag */
+    superseded = GST_BUFFER_DURATION_IS_VALID (buffer) &&
+        lateness >= (GstClockTimeDiff) GST_BUFFER_DURATION (buffer);
+
+    GST_OBJECT_LOCK (lrc);
+    if (lateness > LRC_SINK_LATE_THRESHOLD)
+      lrc->late++;
+    if (lateness > lrc->worst_lateness)
+      lrc->worst_lateness = lateness;
+    if (superseded && lrc->drop_superseded)
+      lrc->dropped++;
+    GST_OBJECT_UNLOCK (lrc);
+
+    if (superseded && lrc->drop_superseded) {
+      GST_DEBUG_OBJECT (lrc, "dropping line %" GST_TIME_FORMAT ", %"
+          G_GINT64_FORMAT " ns late", GST_TIME_ARGS (GST_BUFFER_TIMESTAMP
+              (buffer)), lateness);
+      gst_lrc_sink_post_qos (lrc, buffer, running, lateness);
+      return GST_FLOW_OK;
+    }
+  }
+
+  GST_OBJECT_LOCK (lrc);
+  lrc->rendered++;
+  GST_OBJECT_UNLOCK (lrc);
+
+  gst_lrc_sink_publish (lrc, LRC_SINK_CURRENT, buffer);
+
+  /* one emission for any number of changes until the main loop runs */
+  if (lrc->emit_signals &&
+      g_atomic_int_compare_and_exchange (&lrc->signal_pending, 0, 1))
+    g_idle_add_full (G_PRIORITY_DEFAULT, gst_lrc_sink_emit_line_changed,
+        gst_object_ref (lrc), (GDestroyNotify) gst_object_unref);
+
   return GST_FLOW_OK;
 }
 
@@ -171,9 +801,23 @@ gst_lrc_sink_change_state (GstElement * element, GstStateChange transition)
 {
   GstStateChangeReturn ret = GST_STATE_CHANGE_SUCCESS;
   GstLrcSink *lrc = GST_LRC_SINK (element);
+  gchar *shm_name;
 
   switch (transition) {
     case GST_STATE_CHANGE_READY_TO_PAUSED:
+      GST_OBJECT_LOCK (lrc);
+      lrc->rendered = lrc->dropped = lrc->late = 0;
+      lrc->worst_lateness = 0;
+      shm_name = g_strdup (lrc->shm_name);
+      GST_OBJECT_UNLOCK (lrc);
+      if (shm_name && !(lrc->shm = gst_lrc_shm_new (shm_name))) {
+        GST_ELEMENT_ERROR (lrc, RESOURCE, OPEN_WRITE, (NULL),
+            ("could not create shared memory %s, is another lrcsink "
+                "using it?", shm_name));
+        g_free (shm_name);
+        return GST_STATE_CHANGE_FAILURE;
+      }
+      g_free (shm_name);
       break;
     default:
       break;
@@ -185,7 +829,12 @@ gst_lrc_sink_change_state (GstElement * element, GstStateChange transition)
 
   switch (transition) {
     case GST_STATE_CHANGE_PAUSED_TO_READY:
-
+      gst_lrc_sink_publish (lrc, LRC_SINK_CURRENT, NULL);
+      gst_lrc_sink_publish (lrc, LRC_SINK_NEXT, NULL);
+      if (lrc->shm) {
+        gst_lrc_shm_free (lrc->shm);
+        lrc->shm = NULL;
+      }
       break;
     default:
       break;
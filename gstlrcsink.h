@@ -22,6 +22,7 @@
 
 #include <gst/gst.h>
 #include <gst/base/gstbasesink.h>
+#include "gstlrcshm.h"
 
 G_BEGIN_DECLS
 
@@ -37,6 +38,18 @@ G_BEGIN_DECLS
   (G_TYPE_CHECK_CLASS_TYPE ((klass), GST_TYPE_LRC_SINK))
 
 #define LRC_BLOCK_SIZE 50
+#define LRC_SINK_TEXT_SIZE 256
+
+/* rendered later than this is counted as late */
+#define LRC_SINK_LATE_THRESHOLD (20 * GST_MSECOND)
+
+/* A copy of one lyric line, text is truncated to fit. start is
+ * GST_CLOCK_TIME_NONE when there is no line. */
+typedef struct _GstLrcSinkLine {
+  GstClockTime   start;
+  GstClockTime   stop;
+  gchar          text[LRC_SINK_TEXT_SIZE];
+} GstLrcSinkLine;
 
 typedef struct _GstLrcSink {
   GstBaseSink     parent;
@@ -44,14 +57,48 @@ typedef struct _GstLrcSink {
   /* pads */
   GstPad        *sinkpad;
 
+  /* properity */
+  gboolean emit_signals;
+  gchar *shm_name;
+  gboolean drop_superseded;
+  GstElement *master;
+
+  /* the sink pad of the master, watched for flushing seeks */
+  GstPad *master_pad;
+  gulong master_probe;
+  volatile gint master_flushed;
+
+  /* The line showing and the one waiting for its time. Only the streaming
+   * thread writes them, readers retry while seq is odd or changed. */
+  volatile gint seq;
+  GstLrcSinkLine lines[2];
+
+  /* a line-changed emission is queued on the main context */
+  volatile gint signal_pending;
+
+  /* export to other processes, NULL unless shm-name is set */
+  GstLrcShm *shm;
+
+  /* qos statistics, protected by the object lock */
+  guint64 rendered;
+  guint64 dropped;
+  guint64 late;
+  GstClockTimeDiff worst_lateness;
 } GstLrcSink;
 
 typedef struct _GstLrcSinkClass {
   GstBaseSinkClass parent_class;
+
+  /* signals */
+  void (*line_changed) (GstLrcSink * sink, const gchar * text);
 } GstLrcSinkClass;
 
 GType           gst_lrc_sink_get_type (void);
 
+gboolean        gst_lrc_sink_get_lines (GstLrcSink * sink,
+                                        GstLrcSinkLine * current,
+                                        GstLrcSinkLine * next);
+
 G_END_DECLS
 
 #endif /* __GST_LRC_SINK_H__ */
@@ -0,0 +1,231 @@
+/* GStreamer
+ * Copyright (C) <2008> Zhao Liang <zlweb@163.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <string.h>
+#include <gst/check/gstcheck.h>
+
+#include "gstlrcbinary.h"
+
+/* where the header checksum lives, see gstlrcbinary.c */
+#define HEADER_CHECKSUM_OFFSET 44
+
+static const gchar lyrics[] =
+    "[ti:Title]\n"
+    "[ar:Artist]\n"
+    "[offset:500]\n"
+    "[00:01.00]first\n"
+    "[00:02.00][00:04.00]chorus\n"
+    "[00:03.00]<00:03.00>en<00:03.50>hanced\n";
+
+static GstLrcIndex *
+parse_lyrics (void)
+{
+  GstLrcParser parser;
+  GstLrcIndex *index;
+
+  gst_lrc_parser_init (&parser);
+  gst_lrc_parser_parse (&parser, lyrics, strlen (lyrics));
+  index = gst_lrc_parser_finish (&parser);
+  gst_lrc_parser_clear (&parser);
+
+  return index;
+}
+
+static void
+check_same_index (GstLrcIndex * a, GstLrcIndex * b)
+{
+  guint i;
+
+  assert_equals_int (a->n_cues, b->n_cues);
+  for (i = 0; i < a->n_cues; i++) {
+    assert_equals_uint64 (a->cues[i].start, b->cues[i].start);
+    assert_equals_uint64 (a->cues[i].stop, b->cues[i].stop);
+    assert_equals_int (a->cues[i].length, b->cues[i].length);
+    fail_unless (memcmp (GST_BUFFER_DATA (a->text) + a->cues[i].offset,
+            GST_BUFFER_DATA (b->text) + b->cues[i].offset,
+            a->cues[i].length) == 0);
+  }
+  for (i = 0; i < GST_LRC_TAG_COUNT; i++) {
+    if (a->tags[i])
+      assert_equals_string (a->tags[i], b->tags[i]);
+    else
+      fail_unless (b->tags[i] == NULL);
+  }
+  assert_equals_int (a->offset, b->offset);
+}
+
+/* a copy of buf with its data at an odd address */
+static GstBuffer *
+copy_unaligned (GstBuffer * buf)
+{
+  GstBuffer *big, *sub;
+
+  big = gst_buffer_new_and_alloc (GST_BUFFER_SIZE (buf) + 1);
+  memcpy (GST_BUFFER_DATA (big) + 1, GST_BUFFER_DATA (buf),
+      GST_BUFFER_SIZE (buf));
+  sub = gst_buffer_create_sub (big, 1, GST_BUFFER_SIZE (buf));
+  gst_buffer_unref (big);
+
+  return sub;
+}
+
+/* fix up the header checksum after the header was changed */
+static void
+reseal (GstBuffer * buf)
+{
+  guint8 *data = GST_BUFFER_DATA (buf);
+
+  GST_WRITE_UINT32_LE (data + HEADER_CHECKSUM_OFFSET,
+      gst_lrc_binary_adler32 (data, HEADER_CHECKSUM_OFFSET));
+}
+
+GST_START_TEST (test_adler32)
+{
+  assert_equals_int (gst_lrc_binary_adler32 ((const guint8 *) "", 0), 1);
+  assert_equals_int (gst_lrc_binary_adler32 ((const guint8 *) "Wikipedia",
+          9), 0x11e60398);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_round_trip)
+{
+  GstLrcIndex *index, *read;
+  GstBuffer *buf, *unaligned;
+
+  index = parse_lyrics ();
+  assert_equals_int (index->n_cues, 4);
+  assert_equals_int (index->offset, 500);
+
+  buf = gst_lrc_binary_write (index);
+  fail_unless (gst_lrc_binary_detect (GST_BUFFER_DATA (buf),
+          GST_BUFFER_SIZE (buf)));
+
+  read = gst_lrc_binary_read (buf, TRUE);
+  fail_unless (read != NULL);
+  check_same_index (index, read);
+  gst_lrc_index_unref (read);
+
+  /* the cues are decoded when they can not be used in place */
+  unaligned = copy_unaligned (buf);
+  read = gst_lrc_binary_read (unaligned, TRUE);
+  fail_unless (read != NULL);
+  check_same_index (index, read);
+  gst_lrc_index_unref (read);
+  gst_buffer_unref (unaligned);
+
+  /* the index keeps the data alive */
+  read = gst_lrc_binary_read (buf, FALSE);
+  gst_buffer_unref (buf);
+  check_same_index (index, read);
+  gst_lrc_index_unref (read);
+
+  gst_lrc_index_unref (index);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_corrupt)
+{
+  GstLrcIndex *index, *read;
+  GstBuffer *buf, *bad;
+  guint8 *data;
+  guint size;
+
+  index = parse_lyrics ();
+  buf = gst_lrc_binary_write (index);
+  gst_lrc_index_unref (index);
+  size = GST_BUFFER_SIZE (buf);
+
+  /* too short for a header, or cut off */
+  bad = gst_buffer_create_sub (buf, 0, LRC_BINARY_HEADER_SIZE - 1);
+  fail_if (gst_lrc_binary_detect (GST_BUFFER_DATA (bad),
+          GST_BUFFER_SIZE (bad)));
+  fail_unless (gst_lrc_binary_read (bad, FALSE) == NULL);
+  gst_buffer_unref (bad);
+  bad = gst_buffer_create_sub (buf, 0, size - 1);
+  fail_unless (gst_lrc_binary_read (bad, FALSE) == NULL);
+  gst_buffer_unref (bad);
+
+  /* wrong magic */
+  bad = gst_buffer_copy (buf);
+  GST_BUFFER_DATA (bad)[0] = 'X';
+  fail_unless (gst_lrc_binary_read (bad, FALSE) == NULL);
+  gst_buffer_unref (bad);
+
+  /* unknown version */
+  bad = gst_buffer_copy (buf);
+  GST_WRITE_UINT16_LE (GST_BUFFER_DATA (bad) + 4, LRC_BINARY_VERSION + 1);
+  reseal (bad);
+  fail_unless (gst_lrc_binary_read (bad, FALSE) == NULL);
+  gst_buffer_unref (bad);
+
+  /* damaged header */
+  bad = gst_buffer_copy (buf);
+  GST_BUFFER_DATA (bad)[12] ^= 0x01;
+  fail_unless (gst_lrc_binary_read (bad, FALSE) == NULL);
+  gst_buffer_unref (bad);
+
+  /* sections past the end, with a valid header checksum */
+  bad = gst_buffer_copy (buf);
+  data = GST_BUFFER_DATA (bad);
+  GST_WRITE_UINT32_LE (data + 12, G_MAXUINT32);
+  reseal (bad);
+  fail_unless (gst_lrc_binary_read (bad, FALSE) == NULL);
+  GST_WRITE_UINT32_LE (data + 12, 0);
+  GST_WRITE_UINT32_LE (data + 32, size);
+  reseal (bad);
+  fail_unless (gst_lrc_binary_read (bad, FALSE) == NULL);
+  gst_buffer_unref (bad);
+
+  /* damaged payload, only found when verifying */
+  bad = gst_buffer_copy (buf);
+  GST_BUFFER_DATA (bad)[size - 2] ^= 0x01;
+  fail_unless (gst_lrc_binary_read (bad, TRUE) == NULL);
+  read = gst_lrc_binary_read (bad, FALSE);
+  fail_unless (read != NULL);
+  gst_lrc_index_unref (read);
+  gst_buffer_unref (bad);
+
+  gst_buffer_unref (buf);
+}
+
+GST_END_TEST;
+
+static Suite *
+lrcbinary_suite (void)
+{
+  Suite *s = suite_create ("lrcbinary");
+  TCase *tc_chain = tcase_create ("general");
+
+  gst_lrc_init ();
+
+  suite_add_tcase (s, tc_chain);
+  tcase_add_test (tc_chain, test_adler32);
+  tcase_add_test (tc_chain, test_round_trip);
+  tcase_add_test (tc_chain, test_corrupt);
+
+  return s;
+}
+
+GST_CHECK_MAIN (lrcbinary);
@@ -0,0 +1,168 @@
+/* GStreamer
+ * Copyright (C) <2008> Zhao Liang <zlweb@163.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <string.h>
+#include <gst/check/gstcheck.h>
+
+#include "gstlrccharset.h"
+#include "gstlrcparse.h"
+
+#define FFFD "\xef\xbf\xbd"
+
+/* convert data fed in chunks of chunk bytes, then finish */
+static gchar *
+convert (const gchar * charset, const gchar * data, gsize chunk)
+{
+  GstLrcConverter conv;
+  GString *out = g_string_new (NULL);
+  const gchar *res;
+  gsize size = strlen (data);
+  gsize pos, len;
+
+  gst_lrc_converter_init (&conv, charset);
+  for (pos = 0; pos < size; pos += chunk) {
+    res = gst_lrc_converter_convert (&conv, data + pos,
+        MIN (chunk, size - pos), &len);
+    g_string_append_len (out, res, len);
+  }
+  res = gst_lrc_converter_finish (&conv, &len);
+  g_string_append_len (out, res, len);
+  gst_lrc_converter_clear (&conv);
+
+  return g_string_free (out, FALSE);
+}
+
+/* the same valid UTF-8 comes out whatever the buffers are */
+static void
+check_convert (const gchar * charset, const gchar * data,
+    const gchar * expected)
+{
+  GstLrcConverter conv;
+  const gchar *res;
+  gchar *text;
+  gsize chunk, len;
+
+  for (chunk = 1; chunk <= strlen (data); chunk++) {
+    text = convert (charset, data, chunk);
+    fail_unless (g_utf8_validate (text, -1, NULL));
+    assert_equals_string (text, expected);
+    g_free (text);
+  }
+
+  gst_lrc_converter_init (&conv, charset);
+  res = gst_lrc_converter_convert_all (&conv, data, strlen (data), &len);
+  text = g_strndup (res, len);
+  assert_equals_string (text, expected);
+  g_free (text);
+  gst_lrc_converter_clear (&conv);
+}
+
+GST_START_TEST (test_utf8_valid)
+{
+  check_convert (NULL, "[00:01.00]\xe4\xb8\xad\xe6\x96\x87 ok\n",
+      "[00:01.00]\xe4\xb8\xad\xe6\x96\x87 ok\n");
+  check_convert ("UTF-8", "\xf0\x9f\x8e\xb5 \xc3\xa9",
+      "\xf0\x9f\x8e\xb5 \xc3\xa9");
+  /* the byte order mark is dropped */
+  check_convert (NULL, "\xef\xbb\xbf[ti:\xc3\xa9]", "[ti:\xc3\xa9]");
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_utf8_invalid)
+{
+  /* cut off by the end of the file */
+  check_convert ("UTF-8", "ab\xe4\xb8", "ab" FFFD);
+  check_convert ("UTF-8", "ab\xf0\x9f\x8e", "ab" FFFD);
+
+  /* cut off by a byte that does not continue it */
+  check_convert ("UTF-8", "a\xe4\xb8" "b", "a" FFFD "b");
+  check_convert ("UTF-8", "a\xe4\xe4\xb8\xad", "a" FFFD "\xe4\xb8\xad");
+
+  /* stray continuation and invalid lead bytes */
+  check_convert ("UTF-8", "a\x80" "b\xff", "a" FFFD "b" FFFD);
+  check_convert ("UTF-8", "\xc0\xaf", FFFD FFFD);
+
+  /* the second byte is limited after E0, ED, F0 and F4 */
+  check_convert ("UTF-8", "\xe0\x80\x80", FFFD FFFD FFFD);
+  check_convert ("UTF-8", "\xed\xa0\x80", FFFD FFFD FFFD);
+  check_convert ("UTF-8", "\xf0\x80\x80\x80", FFFD FFFD FFFD FFFD);
+  check_convert ("UTF-8", "\xf4\x90\x80\x80", FFFD FFFD FFFD FFFD);
+  check_convert ("UTF-8", "\xe0\xa0\x80\xf4\x8f\xbf\xbf",
+      "\xe0\xa0\x80\xf4\x8f\xbf\xbf");
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_gbk)
+{
+  /* "zhong wen" in GBK, given and detected */
+  check_convert ("GBK", "[ti:\xd6\xd0\xce\xc4]\n",
+      "[ti:\xe4\xb8\xad\xe6\x96\x87]\n");
+  check_convert (NULL, "[ti:\xd6\xd0\xce\xc4]\n",
+      "[ti:\xe4\xb8\xad\xe6\x96\x87]\n");
+
+  /* a double byte character cut off by the end of the file */
+  check_convert ("GBK", "a\xd6\xd0\xce", "a\xe4\xb8\xad" FFFD);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_reset)
+{
+  GstLrcConverter conv;
+  const gchar *res;
+  gsize len;
+
+  /* a reset drops the held back sequence but keeps the charset */
+  gst_lrc_converter_init (&conv, "UTF-8");
+  res = gst_lrc_converter_convert (&conv, "a\xe4\xb8", 3, &len);
+  assert_equals_int (len, 1);
+  fail_unless (res[0] == 'a');
+  gst_lrc_converter_reset (&conv);
+  res = gst_lrc_converter_convert_all (&conv, "\xad" "b", 2, &len);
+  assert_equals_int (len, 4);
+  fail_unless (memcmp (res, FFFD "b", 4) == 0);
+  gst_lrc_converter_clear (&conv);
+}
+
+GST_END_TEST;
+
+static Suite *
+lrccharset_suite (void)
+{
+  Suite *s = suite_create ("lrccharset");
+  TCase *tc_chain = tcase_create ("general");
+
+  gst_lrc_init ();
+
+  suite_add_tcase (s, tc_chain);
+  tcase_add_test (tc_chain, test_utf8_valid);
+  tcase_add_test (tc_chain, test_utf8_invalid);
+  tcase_add_test (tc_chain, test_gbk);
+  tcase_add_test (tc_chain, test_reset);
+
+  return s;
+}
+
+GST_CHECK_MAIN (lrccharset);
@@ -0,0 +1,395 @@
+/* GStreamer
+ * Copyright (C) <2008> Zhao Liang <zlweb@163.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <string.h>
+#include <gst/check/gstcheck.h>
+
+#include "gstlrcparse.h"
+
+/* the scanner places each line where it is in the text */
+static void
+check_offset (GstLrcLineScanner * scanner, const gchar * text,
+    const gchar * line, gsize len)
+{
+  guint64 offset = scanner->offset;
+
+  fail_unless (memcmp (text + offset, line, len) == 0,
+      "line '%.*s' is not at %" G_GUINT64_FORMAT, (gint) len, line, offset);
+  fail_unless (offset == 0 || text[offset - 1] == '\n' ||
+      text[offset - 1] == '\r');
+}
+
+/* feed text in chunks of chunk bytes, the lines come back joined by '|' */
+static gchar *
+scan_lines (const gchar * text, gsize chunk)
+{
+  GstLrcLineScanner scanner;
+  GString *out = g_string_new (NULL);
+  const gchar *line;
+  gsize size = strlen (text);
+  gsize pos, len;
+
+  gst_lrc_line_scanner_init (&scanner);
+  for (pos = 0; pos < size; pos += chunk) {
+    gst_lrc_line_scanner_feed (&scanner, text + pos, MIN (chunk, size - pos));
+    while (gst_lrc_line_scanner_next (&scanner, &line, &len)) {
+      check_offset (&scanner, text, line, len);
+      g_string_append_printf (out, "%.*s|", (gint) len, line);
+    }
+  }
+  if (gst_lrc_line_scanner_finish (&scanner, &line, &len)) {
+    check_offset (&scanner, text, line, len);
+    g_string_append_printf (out, "%.*s|", (gint) len, line);
+  }
+  gst_lrc_line_scanner_clear (&scanner);
+
+  return g_string_free (out, FALSE);
+}
+
+static void
+check_lines (const gchar * text, const gchar * expected)
+{
+  gchar *lines;
+  gsize chunk;
+
+  for (chunk = 1; chunk <= strlen (text); chunk++) {
+    lines = scan_lines (text, chunk);
+    fail_unless (strcmp (lines, expected) == 0,
+        "chunks of %u: got '%s', expected '%s'", (guint) chunk, lines,
+        expected);
+    g_free (lines);
+  }
+}
+
+GST_START_TEST (test_scanner_line_ends)
+{
+  check_lines ("[00:01.00]a\n[00:02.00]b\n", "[00:01.00]a|[00:02.00]b|");
+  check_lines ("[00:01.00]a\r\n[00:02.00]b\r\n", "[00:01.00]a|[00:02.00]b|");
+  check_lines ("[00:01.00]a\r[00:02.00]b\r", "[00:01.00]a|[00:02.00]b|");
+  check_lines ("a\r\n\r\nb\n\nc", "a||b||c|");
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_scanner_split_lines)
+{
+  GstLrcLineScanner scanner;
+  const gchar *line;
+  gsize len;
+
+  gst_lrc_line_scanner_init (&scanner);
+
+  /* a line split over three buffers is handed out once it is complete */
+  gst_lrc_line_scanner_feed (&scanner, "[00:01.00]hel", 13);
+  fail_if (gst_lrc_line_scanner_next (&scanner, &line, &len));
+  gst_lrc_line_scanner_feed (&scanner, "lo wor", 6);
+  fail_if (gst_lrc_line_scanner_next (&scanner, &line, &len));
+  gst_lrc_line_scanner_feed (&scanner, "ld\r", 3);
+  fail_unless (gst_lrc_line_scanner_next (&scanner, &line, &len));
+  fail_unless (len == 21);
+  fail_unless (memcmp (line, "[00:01.00]hello world", 21) == 0);
+  fail_unless (scanner.offset == 0);
+  fail_if (gst_lrc_line_scanner_next (&scanner, &line, &len));
+
+  /* the '\n' of a split "\r\n" does not make an empty line */
+  gst_lrc_line_scanner_feed (&scanner, "\n[00:02", 7);
+  fail_if (gst_lrc_line_scanner_next (&scanner, &line, &len));
+
+  /* the unterminated last line is left for finish */
+  gst_lrc_line_scanner_feed (&scanner, ".00]end", 7);
+  fail_if (gst_lrc_line_scanner_next (&scanner, &line, &len));
+  fail_unless (gst_lrc_line_scanner_finish (&scanner, &line, &len));
+  fail_unless (len == 13);
+  fail_unless (memcmp (line, "[00:02.00]end", 13) == 0);
+  fail_unless (scanner.offset == 23);
+  fail_if (gst_lrc_line_scanner_finish (&scanner, &line, &len));
+
+  gst_lrc_line_scanner_clear (&scanner);
+}
+
+GST_END_TEST;
+
+/* the start of the first cue of a line, NONE if it is not a timed line */
+static GstClockTime
+parse_stamp (const gchar * line, gsize len)
+{
+  GstLrcParser parser;
+  GstClockTime start = GST_CLOCK_TIME_NONE;
+
+  gst_lrc_parser_init (&parser);
+  if (gst_lrc_parse_line (&parser, line, len))
+    start = g_array_index (parser.cues, GstLrcCue, 0).start;
+  gst_lrc_parser_clear (&parser);
+
+  return start;
+}
+
+#define STAMP(line) parse_stamp (line, strlen (line))
+#define MSEC(m) ((GstClockTime) (m) * GST_MSECOND)
+
+GST_START_TEST (test_timestamp_formats)
+{
+  assert_equals_uint64 (STAMP ("[01:02]a"), MSEC (62000));
+  assert_equals_uint64 (STAMP ("[01:02.3]a"), MSEC (62300));
+  assert_equals_uint64 (STAMP ("[01:02.34]a"), MSEC (62340));
+  assert_equals_uint64 (STAMP ("[01:02.345]a"), MSEC (62345));
+  assert_equals_uint64 (STAMP ("[01:02.3456]a"), MSEC (62345));
+  assert_equals_uint64 (STAMP ("[1:02:03.50]a"), MSEC (3723500));
+  assert_equals_uint64 (STAMP ("[123:00]a"), MSEC (7380000));
+  assert_equals_uint64 (STAMP ("[00:00.00]"), 0);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_timestamp_invalid)
+{
+  fail_if (GST_CLOCK_TIME_IS_VALID (STAMP ("[01]a")));
+  fail_if (GST_CLOCK_TIME_IS_VALID (STAMP ("[01:]a")));
+  fail_if (GST_CLOCK_TIME_IS_VALID (STAMP ("[:02]a")));
+  fail_if (GST_CLOCK_TIME_IS_VALID (STAMP ("[01:02.]a")));
+  fail_if (GST_CLOCK_TIME_IS_VALID (STAMP ("[01:02:03:04]a")));
+  fail_if (GST_CLOCK_TIME_IS_VALID (STAMP ("[a1:02]a")));
+  fail_if (GST_CLOCK_TIME_IS_VALID (STAMP ("[01:02>a")));
+  fail_if (GST_CLOCK_TIME_IS_VALID (STAMP ("[01:02")));
+  fail_if (GST_CLOCK_TIME_IS_VALID (STAMP ("[1234567890:00]a")));
+  fail_if (GST_CLOCK_TIME_IS_VALID (STAMP ("01:02]a")));
+
+  /* the tokenizer stops at the end of the line, not at a NUL */
+  fail_if (GST_CLOCK_TIME_IS_VALID (parse_stamp ("[01:02.00]a", 9)));
+  fail_if (GST_CLOCK_TIME_IS_VALID (parse_stamp ("[01:02.00]a", 6)));
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_timestamp_lines)
+{
+  GstLrcParser parser;
+  GstLrcCue *cue;
+  const gchar *line = "[00:01.00][00:03.50]chorus";
+
+  gst_lrc_parser_init (&parser);
+  fail_unless (gst_lrc_parse_line (&parser, line, strlen (line)));
+  assert_equals_int (parser.cues->len, 2);
+  cue = (GstLrcCue *) parser.cues->data;
+  assert_equals_uint64 (cue[0].start, MSEC (1000));
+  assert_equals_uint64 (cue[1].start, MSEC (3500));
+  assert_equals_int (cue[0].offset, cue[1].offset);
+  assert_equals_int (cue[0].length, 6);
+  fail_unless (memcmp (parser.text->data + cue[0].offset, "chorus", 6) == 0);
+  gst_lrc_parser_clear (&parser);
+
+  assert_equals_int (gst_lrc_classify_line ("[00:01.00]a", 11),
+      GST_LRC_LINE_TIMED);
+  assert_equals_int (gst_lrc_classify_line ("[ti:title]", 10),
+      GST_LRC_LINE_TAG);
+  assert_equals_int (gst_lrc_classify_line ("[xx:value]", 10),
+      GST_LRC_LINE_OTHER);
+  assert_equals_int (gst_lrc_classify_line ("plain text", 10),
+      GST_LRC_LINE_OTHER);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_intern_table)
+{
+  GstLrcInternTable table;
+  GByteArray *text = g_byte_array_new ();
+  guint32 offsets[200];
+  gchar *str;
+  guint32 a, ab, abc;
+  guint i;
+
+  gst_lrc_intern_table_init (&table);
+
+  /* equal strings share their offset, prefixes do not */
+  abc = gst_lrc_intern_table_add (&table, text, "abc", 3);
+  ab = gst_lrc_intern_table_add (&table, text, "ab", 2);
+  a = gst_lrc_intern_table_add (&table, text, "abc", 1);
+  fail_if (ab == abc);
+  fail_if (a == abc || a == ab);
+  assert_equals_int (gst_lrc_intern_table_add (&table, text, "abc", 3), abc);
+  assert_equals_int (gst_lrc_intern_table_add (&table, text, "ab", 2), ab);
+  assert_equals_string ((gchar *) text->data + abc, "abc");
+  assert_equals_string ((gchar *) text->data + ab, "ab");
+  assert_equals_string ((gchar *) text->data + a, "a");
+
+  /* the table grows past its initial size without losing strings */
+  for (i = 0; i < G_N_ELEMENTS (offsets); i++) {
+    str = g_strdup_printf ("line %u", i);
+    offsets[i] = gst_lrc_intern_table_add (&table, text, str, strlen (str));
+    g_free (str);
+  }
+  for (i = 0; i < G_N_ELEMENTS (offsets); i++) {
+    str = g_strdup_printf ("line %u", i);
+    assert_equals_int (gst_lrc_intern_table_add (&table, text, str,
+            strlen (str)), offsets[i]);
+    assert_equals_string ((gchar *) text->data + offsets[i], str);
+    g_free (str);
+  }
+
+  /* a reset table starts over on an emptied text block */
+  g_byte_array_set_size (text, 0);
+  gst_lrc_intern_table_reset (&table);
+  assert_equals_int (gst_lrc_intern_table_add (&table, text, "ab", 2), 0);
+
+  gst_lrc_intern_table_clear (&table);
+  g_byte_array_free (text, TRUE);
+}
+
+GST_END_TEST;
+
+/* the text of cue n of index */
+static const gchar *
+cue_text (GstLrcIndex * index, guint n)
+{
+  return (const gchar *) GST_BUFFER_DATA (index->text) + index->cues[n].offset;
+}
+
+GST_START_TEST (test_cues_order)
+{
+  GstLrcParser parser;
+  GstLrcIndex *index;
+  const gchar *text = "[00:02.00]b\n[00:01.00]a\n[00:02.00]c\n"
+      "[00:02.00][00:00.50]b\n";
+
+  gst_lrc_parser_init (&parser);
+  gst_lrc_parser_parse (&parser, text, strlen (text));
+  index = gst_lrc_parser_finish (&parser);
+
+  /* equal timestamps keep the order of the file */
+  assert_equals_int (index->n_cues, 5);
+  assert_equals_string (cue_text (index, 0), "b");
+  assert_equals_string (cue_text (index, 1), "a");
+  assert_equals_string (cue_text (index, 2), "b");
+  assert_equals_string (cue_text (index, 3), "c");
+  assert_equals_string (cue_text (index, 4), "b");
+  assert_equals_int (index->cues[0].offset, index->cues[2].offset);
+
+  /* a cue stops where the next later cue starts */
+  assert_equals_uint64 (index->cues[0].stop, MSEC (1000));
+  assert_equals_uint64 (index->cues[1].stop, MSEC (2000));
+  fail_if (GST_CLOCK_TIME_IS_VALID (index->cues[2].stop));
+  fail_if (GST_CLOCK_TIME_IS_VALID (index->cues[4].stop));
+
+  gst_lrc_index_unref (index);
+  gst_lrc_parser_clear (&parser);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_cues_find)
+{
+  GstLrcCue cues[4] = {
+    {MSEC (1000), 0, 0, 0},
+    {MSEC (3000), 0, 0, 0},
+    {MSEC (3000), 0, 0, 0},
+    {MSEC (5000), 0, 0, 0}
+  };
+  GArray *sorted;
+
+  /* the stops come from sorting: 3 s, 5 s, 5 s and open */
+  sorted = g_array_new (FALSE, FALSE, sizeof (GstLrcCue));
+  g_array_append_vals (sorted, cues, 4);
+  gst_lrc_cues_sort (sorted);
+  memcpy (cues, sorted->data, sizeof (cues));
+  g_array_free (sorted, TRUE);
+
+  /* the first cue that is still showing or yet to come */
+  assert_equals_int (gst_lrc_cues_find (cues, 4, 0), 0);
+  assert_equals_int (gst_lrc_cues_find (cues, 4, MSEC (1000)), 0);
+  assert_equals_int (gst_lrc_cues_find (cues, 4, MSEC (2999)), 0);
+  assert_equals_int (gst_lrc_cues_find (cues, 4, MSEC (3000)), 1);
+  assert_equals_int (gst_lrc_cues_find (cues, 4, MSEC (4999)), 1);
+  assert_equals_int (gst_lrc_cues_find (cues, 4, MSEC (5000)), 3);
+  assert_equals_int (gst_lrc_cues_find (cues, 4, MSEC (60000)), 3);
+
+  /* n_cues when all cues are over */
+  assert_equals_int (gst_lrc_cues_find (cues, 3, MSEC (5000)), 3);
+  assert_equals_int (gst_lrc_cues_find (cues, 0, 0), 0);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_words_shift)
+{
+  GstLrcParser parser;
+  GstLrcIndex *index;
+  GstLrcWord word;
+  const gchar *text = "[00:03.00]<00:03.00>en<00:03.50>hanced\n";
+  guint8 *data;
+  gsize size;
+
+  gst_lrc_parser_init (&parser);
+  gst_lrc_parser_parse (&parser, text, strlen (text));
+  index = gst_lrc_parser_finish (&parser);
+  assert_equals_int (index->n_cues, 1);
+  assert_equals_string (cue_text (index, 0), "enhanced");
+
+  size = index->cues[0].length + 1;
+  data = g_malloc (size);
+  memcpy (data, GST_BUFFER_DATA (index->text) + index->cues[0].offset, size);
+  assert_equals_int (gst_lrc_words_count (data, size), 2);
+  fail_unless (gst_lrc_words_get (data, size, 1, &word));
+  assert_equals_uint64 (word.start, MSEC (500));
+
+  /* clipped to 3.2 s, the first word was already showing */
+  gst_lrc_words_shift (data, size, MSEC (200));
+  fail_unless (gst_lrc_words_get (data, size, 0, &word));
+  assert_equals_uint64 (word.start, 0);
+  assert_equals_int (word.offset, 0);
+  assert_equals_int (word.length, 2);
+  fail_unless (gst_lrc_words_get (data, size, 1, &word));
+  assert_equals_uint64 (word.start, MSEC (300));
+  assert_equals_int (word.offset, 2);
+  assert_equals_int (word.length, 6);
+
+  g_free (data);
+  gst_lrc_index_unref (index);
+  gst_lrc_parser_clear (&parser);
+}
+
+GST_END_TEST;
+
+static Suite *
+lrcparse_suite (void)
+{
+  Suite *s = suite_create ("lrcparse");
+  TCase *tc_chain = tcase_create ("general");
+
+  gst_lrc_init ();
+
+  suite_add_tcase (s, tc_chain);
+  tcase_add_test (tc_chain, test_scanner_line_ends);
+  tcase_add_test (tc_chain, test_scanner_split_lines);
+  tcase_add_test (tc_chain, test_timestamp_formats);
+  tcase_add_test (tc_chain, test_timestamp_invalid);
+  tcase_add_test (tc_chain, test_timestamp_lines);
+  tcase_add_test (tc_chain, test_intern_table);
+  tcase_add_test (tc_chain, test_cues_order);
+  tcase_add_test (tc_chain, test_cues_find);
+  tcase_add_test (tc_chain, test_words_shift);
+
+  return s;
+}
+
+GST_CHECK_MAIN (lrcparse);
@@ -0,0 +1,226 @@
+/* GStreamer
+ * Copyright (C) <2008> Zhao Liang <zlweb@163.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <string.h>
+#include <gst/check/gstcheck.h>
+
+#include "gstlrcbinary.h"
+#include "gstlrcsearch.h"
+
+static GstLrcIndex *
+parse_lyrics (const gchar * text)
+{
+  GstLrcParser parser;
+  GstLrcIndex *index;
+
+  gst_lrc_parser_init (&parser);
+  gst_lrc_parser_parse (&parser, text, strlen (text));
+  index = gst_lrc_parser_finish (&parser);
+  gst_lrc_parser_clear (&parser);
+
+  return index;
+}
+
+static GstLrcSearch *
+create_search (void)
+{
+  GstLrcSearch *search = gst_lrc_search_new ();
+  GstLrcIndex *index;
+
+  index = parse_lyrics ("[00:01.00]Hello world\n"
+      "[00:02.00]goodbye\n" "[00:03.00]hello, cruel world\n");
+  assert_equals_int (gst_lrc_search_add (search, "a.lrc", index), 0);
+  gst_lrc_index_unref (index);
+
+  index = parse_lyrics ("[00:05.00]the world says hello\n"
+      "[00:04.00]nothing here\n");
+  assert_equals_int (gst_lrc_search_add (search, "b.lrc", index), 1);
+  gst_lrc_index_unref (index);
+
+  return search;
+}
+
+/* the hits of a query as "file:cue@seconds" joined by spaces */
+static gchar *
+query (GstLrcSearch * search, const gchar * text, gint file)
+{
+  GString *out = g_string_new (NULL);
+  GstLrcSearchHit *hit;
+  GArray *hits;
+  guint i;
+
+  hits = gst_lrc_search_query (search, text, file);
+  for (i = 0; i < hits->len; i++) {
+    hit = &g_array_index (hits, GstLrcSearchHit, i);
+    g_string_append_printf (out, "%s%u:%u@%u", i ? " " : "", hit->file,
+        hit->cue, (guint) (hit->time / GST_SECOND));
+  }
+  g_array_free (hits, TRUE);
+
+  return g_string_free (out, FALSE);
+}
+
+static void
+check_query (GstLrcSearch * search, const gchar * text, gint file,
+    const gchar * expected)
+{
+  gchar *hits = query (search, text, file);
+
+  assert_equals_string (hits, expected);
+  g_free (hits);
+}
+
+static void
+check_queries (GstLrcSearch * search)
+{
+  check_query (search, "hello world", -1, "0:0@1 0:2@3 1:1@5");
+  check_query (search, "WORLD Hello", -1, "0:0@1 0:2@3 1:1@5");
+  check_query (search, "hello world", 1, "1:1@5");
+  check_query (search, "cruel", -1, "0:2@3");
+  check_query (search, "goodbye world", -1, "");
+  check_query (search, "missing", -1, "");
+  check_query (search, "", -1, "");
+}
+
+GST_START_TEST (test_search_query)
+{
+  GstLrcSearch *search = create_search ();
+
+  assert_equals_int (gst_lrc_search_get_n_files (search), 2);
+  assert_equals_string (gst_lrc_search_get_name (search, 1), "b.lrc");
+  check_queries (search);
+
+  gst_lrc_search_free (search);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_search_round_trip)
+{
+  GstLrcSearch *search = create_search ();
+  GstLrcSearch *read;
+  GstLrcIndex *index;
+  GstBuffer *buf, *again;
+
+  buf = gst_lrc_search_write (search);
+  gst_lrc_search_free (search);
+
+  read = gst_lrc_search_read (buf);
+  fail_unless (read != NULL);
+  assert_equals_int (gst_lrc_search_get_n_files (read), 2);
+  assert_equals_string (gst_lrc_search_get_name (read, 0), "a.lrc");
+  assert_equals_string (gst_lrc_search_get_name (read, 1), "b.lrc");
+  check_queries (read);
+
+  /* writing a read index gives the same bytes */
+  again = gst_lrc_search_write (read);
+  assert_equals_int (GST_BUFFER_SIZE (again), GST_BUFFER_SIZE (buf));
+  fail_unless (memcmp (GST_BUFFER_DATA (again), GST_BUFFER_DATA (buf),
+          GST_BUFFER_SIZE (buf)) == 0);
+  gst_buffer_unref (again);
+
+  /* and it can still be added to */
+  index = parse_lyrics ("[00:07.00]hello world again\n");
+  assert_equals_int (gst_lrc_search_add (read, "c.lrc", index), 2);
+  gst_lrc_index_unref (index);
+  check_query (read, "hello world", -1, "0:0@1 0:2@3 1:1@5 2:0@7");
+
+  gst_lrc_search_free (read);
+  gst_buffer_unref (buf);
+
+  /* an empty index */
+  search = gst_lrc_search_new ();
+  buf = gst_lrc_search_write (search);
+  gst_lrc_search_free (search);
+  read = gst_lrc_search_read (buf);
+  fail_unless (read != NULL);
+  assert_equals_int (gst_lrc_search_get_n_files (read), 0);
+  check_query (read, "hello", -1, "");
+  gst_lrc_search_free (read);
+  gst_buffer_unref (buf);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_search_corrupt)
+{
+  GstLrcSearch *search = create_search ();
+  GstLrcIndex *index;
+  GstBuffer *buf, *bad;
+  guint size;
+
+  buf = gst_lrc_search_write (search);
+  gst_lrc_search_free (search);
+  size = GST_BUFFER_SIZE (buf);
+
+  bad = gst_buffer_create_sub (buf, 0, LRC_SEARCH_HEADER_SIZE - 1);
+  fail_unless (gst_lrc_search_read (bad) == NULL);
+  gst_buffer_unref (bad);
+  bad = gst_buffer_create_sub (buf, 0, size - 1);
+  fail_unless (gst_lrc_search_read (bad) == NULL);
+  gst_buffer_unref (bad);
+
+  bad = gst_buffer_copy (buf);
+  GST_BUFFER_DATA (bad)[0] = 'X';
+  fail_unless (gst_lrc_search_read (bad) == NULL);
+  gst_buffer_unref (bad);
+
+  bad = gst_buffer_copy (buf);
+  GST_BUFFER_DATA (bad)[8] ^= 0x01;
+  fail_unless (gst_lrc_search_read (bad) == NULL);
+  gst_buffer_unref (bad);
+
+  bad = gst_buffer_copy (buf);
+  GST_BUFFER_DATA (bad)[size - 2] ^= 0x01;
+  fail_unless (gst_lrc_search_read (bad) == NULL);
+  gst_buffer_unref (bad);
+
+  gst_buffer_unref (buf);
+
+  /* a binary lyrics index is not a search index */
+  index = parse_lyrics ("[00:01.00]hello\n");
+  buf = gst_lrc_binary_write (index);
+  gst_lrc_index_unref (index);
+  fail_unless (gst_lrc_search_read (buf) == NULL);
+  gst_buffer_unref (buf);
+}
+
+GST_END_TEST;
+
+static Suite *
+lrcsearch_suite (void)
+{
+  Suite *s = suite_create ("lrcsearch");
+  TCase *tc_chain = tcase_create ("general");
+
+  gst_lrc_init ();
+
+  suite_add_tcase (s, tc_chain);
+  tcase_add_test (tc_chain, test_search_query);
+  tcase_add_test (tc_chain, test_search_round_trip);
+  tcase_add_test (tc_chain, test_search_corrupt);
+
+  return s;
+}
+
+GST_CHECK_MAIN (lrcsearch);